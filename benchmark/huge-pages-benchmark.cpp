@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "huge-pages.hpp"
+#include "yuyv-converter.hpp"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Measures the conversion of YUYV frames into an I420 and an ARGB frame in a
+// shared memory area and the throughput of a reader process consuming the
+// area, once with 4 KB pages and once with 2 MB transparent huge pages.
+// Readers walk the ARGB frame row by row (sequential) and in columns of 64
+// bytes from top to bottom (vertical), which touches a new 4 KB page per row.
+
+static const std::string NAME{"/opendlv-device-camera-pylon-hugepages"};
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// Results of a reader process sent to the writer through a pipe.
+struct ReaderResult {
+    double sequential{0};
+    double vertical{0};
+    uint64_t hugeBytes{0};
+};
+
+static void reader(int fd, bool hugePages, uint32_t width, uint32_t height, uint32_t frames) {
+    cluon::SharedMemory sharedMemory{NAME};
+    if (!sharedMemory.valid()) {
+        _exit(1);
+    }
+    if (hugePages) {
+        hugepages::advise(sharedMemory.data(), sharedMemory.size());
+    }
+    const uint64_t *argb{reinterpret_cast<const uint64_t*>(sharedMemory.data() + width * height * 3 / 2)};
+    const uint32_t WORDS_PER_ROW{width * 4 / 8};
+    std::vector<double> sequential, vertical;
+    volatile uint64_t sink{0};
+    for (uint32_t n{0}; n < frames; n++) {
+        uint64_t sum{0};
+        auto start{std::chrono::steady_clock::now()};
+        for (uint32_t i{0}; i < WORDS_PER_ROW * height; i++) {
+            sum += argb[i];
+        }
+        sequential.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        start = std::chrono::steady_clock::now();
+        for (uint32_t column{0}; column < WORDS_PER_ROW; column += 8) {
+            for (uint32_t y{0}; y < height; y++) {
+                const uint64_t *p{argb + y * WORDS_PER_ROW + column};
+                sum += p[0] + p[1] + p[2] + p[3] + p[4] + p[5] + p[6] + p[7];
+            }
+        }
+        vertical.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        sink = sink + sum;
+    }
+    const double GB{width * height * 4 / 1e9};
+    ReaderResult result;
+    result.sequential = GB / median(sequential);
+    result.vertical = GB / median(vertical);
+    result.hugeBytes = hugepages::mappedBytes(sharedMemory.data());
+    if (sizeof(result) != write(fd, &result, sizeof(result))) {
+        _exit(1);
+    }
+}
+
+static void run(bool hugePages, uint32_t width, uint32_t height, uint32_t frames) {
+    const uint32_t SIZE_I420{width * height * 3 / 2};
+    const uint32_t SIZE_ARGB{width * height * 4};
+    std::unique_ptr<cluon::SharedMemory> sharedMemory(new cluon::SharedMemory{NAME, SIZE_I420 + SIZE_ARGB});
+    if (!sharedMemory->valid()) {
+        std::cerr << "Failed to create shared memory '" << NAME << "'." << std::endl;
+        return;
+    }
+    if (hugePages && !hugepages::advise(sharedMemory->data(), sharedMemory->size())) {
+        std::cerr << "Failed to request huge pages." << std::endl;
+    }
+
+    // A frame with a gradient in luma and chroma.
+    std::vector<uint8_t> yuyv(width * height * 2);
+    for (uint32_t i{0}; i < yuyv.size(); i++) {
+        yuyv[i] = static_cast<uint8_t>(i * 7 + i / (width * 2));
+    }
+    uint8_t *dstY{reinterpret_cast<uint8_t*>(sharedMemory->data())};
+    uint8_t *dstU{dstY + width * height};
+    uint8_t *dstV{dstU + width * height / 4};
+    uint8_t *dstARGB{dstY + SIZE_I420};
+
+    // The first conversion faults in the pages.
+    auto start{std::chrono::steady_clock::now()};
+    yuyv::toI420AndARGB(yuyv.data(), width * 2, dstY, dstU, dstV, dstARGB, width, 0, height);
+    const double FIRST{std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()};
+    std::vector<double> conversions;
+    for (uint32_t n{0}; n < frames; n++) {
+        start = std::chrono::steady_clock::now();
+        yuyv::toI420AndARGB(yuyv.data(), width * 2, dstY, dstU, dstV, dstARGB, width, 0, height);
+        conversions.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    int fds[2];
+    if (0 != pipe(fds)) {
+        return;
+    }
+    const pid_t pid{fork()};
+    if (0 == pid) {
+        reader(fds[1], hugePages, width, height, frames);
+        _exit(0);
+    }
+    ReaderResult result;
+    const bool READ{sizeof(result) == read(fds[0], &result, sizeof(result))};
+    waitpid(pid, nullptr, 0);
+    if (!READ) {
+        std::cerr << "Reader failed." << std::endl;
+        return;
+    }
+    std::cout << std::setw(8) << (hugePages ? "2 MB" : "4 KB")
+              << std::setw(12) << std::fixed << std::setprecision(2) << FIRST
+              << std::setw(14) << median(conversions)
+              << std::setw(13) << result.sequential
+              << std::setw(17) << result.vertical
+              << std::setw(9) << (result.hugeBytes >> 20) << std::endl;
+}
+
+int32_t main(int32_t argc, char **argv) {
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    const uint32_t WIDTH{static_cast<uint32_t>((commandlineArguments.count("width") != 0) ? std::stoi(commandlineArguments["width"]) : 4096)};
+    const uint32_t HEIGHT{static_cast<uint32_t>((commandlineArguments.count("height") != 0) ? std::stoi(commandlineArguments["height"]) : 2160)};
+    const uint32_t FRAMES{static_cast<uint32_t>((commandlineArguments.count("frames") != 0) ? std::stoi(commandlineArguments["frames"]) : 50)};
+
+    std::cout << "Conversion of " << WIDTH << "x" << HEIGHT << " YUYV frames into I420 and ARGB (" << yuyv::kernelName() << ") and reading the ARGB frame in another process (" << FRAMES << " frames per run)" << std::endl;
+    std::cout << "Transparent huge pages for shared memory: '" << hugepages::shmemPolicy() << "'" << std::endl;
+    std::cout << "   pages  first (ms)  convert (ms)  read (GB/s)  vertical (GB/s)  huge MB" << std::endl;
+    for (bool hugePages : {false, true}) {
+        // Every run uses a separate process to start from a fresh shared memory area.
+        const pid_t pid{fork()};
+        if (0 == pid) {
+            run(hugePages, WIDTH, HEIGHT, FRAMES);
+            _exit(0);
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    {
+        // Remove the shared memory area of the last run.
+        cluon::SharedMemory cleanup{NAME, 1};
+    }
+    return 0;
+}
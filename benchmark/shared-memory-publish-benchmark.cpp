@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cluon-complete.hpp"
+#include "shared-memory-layout.hpp"
+
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures the latency of the producer publishing a frame into a shared memory
+// area while a given number of reader processes consume every frame, once
+// using the shared memory's process-shared mutex and once using the seqlock
+// of the ring layout with a single slot.
+
+static void reader(const std::string &name, bool seqlock, uint32_t frameSize) {
+    cluon::SharedMemory sharedMemory{name};
+    if (!sharedMemory.valid()) {
+        _exit(1);
+    }
+    std::vector<char> copy(frameSize);
+    FrameRingHeader *ring{seqlock ? reinterpret_cast<FrameRingHeader*>(sharedMemory.data()) : nullptr};
+    for (;;) {
+        sharedMemory.wait();
+        if (seqlock) {
+            // Retry until the slot was not overwritten while being copied.
+            FrameSlotHeader &slot{ring->slotHeader(0)};
+            uint64_t before{0};
+            uint64_t after{0};
+            do {
+                before = slot.sequence.load(std::memory_order_acquire);
+                std::memcpy(copy.data(), ring->slotData(0), frameSize);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = slot.sequence.load(std::memory_order_relaxed);
+            } while ((before != after) || (0 != (before % 2)));
+        }
+        else {
+            sharedMemory.lock();
+            std::memcpy(copy.data(), sharedMemory.data(), frameSize);
+            sharedMemory.unlock();
+        }
+    }
+}
+
+static const std::string NAME{"/opendlv-device-camera-pylon-benchmark"};
+
+static void run(bool seqlock, uint32_t readers, uint32_t width, uint32_t height, uint32_t frames) {
+    const uint32_t FRAME_SIZE{width * height * 3 / 2};
+    std::unique_ptr<cluon::SharedMemory> sharedMemory(new cluon::SharedMemory{NAME, seqlock ? FrameRingHeader::sizeOfArea(1, FRAME_SIZE) : FRAME_SIZE});
+    if (!sharedMemory->valid()) {
+        std::cerr << "Failed to create shared memory '" << NAME << "'." << std::endl;
+        return;
+    }
+    FrameRingHeader *ring{seqlock ? FrameRingHeader::create(sharedMemory->data(), width, height, 1, FRAME_SIZE) : nullptr};
+
+    std::vector<pid_t> children;
+    for (uint32_t i{0}; i < readers; i++) {
+        const pid_t pid{fork()};
+        if (0 == pid) {
+            reader(NAME, seqlock, FRAME_SIZE);
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+    // Let the readers attach.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::vector<char> frame(FRAME_SIZE, 42);
+    std::vector<int64_t> latencies;
+    latencies.reserve(frames);
+    for (uint64_t n{1}; n <= frames; n++) {
+        const auto start{std::chrono::steady_clock::now()};
+        if (seqlock) {
+            std::memcpy(ring->beginWrite(n, 0, 0), frame.data(), FRAME_SIZE);
+            ring->endWrite(n);
+        }
+        else {
+            sharedMemory->lock();
+            std::memcpy(sharedMemory->data(), frame.data(), FRAME_SIZE);
+            sharedMemory->unlock();
+        }
+        sharedMemory->notifyAll();
+        latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        // Simulate a camera running at 100 fps.
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(10));
+    }
+
+    for (auto pid : children) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p) {
+        return latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(p * static_cast<double>(latencies.size())))];
+    };
+    std::cout << std::setw(8) << (seqlock ? "seqlock" : "lock") << std::setw(9) << readers
+              << std::setw(10) << percentile(0.5) << std::setw(10) << percentile(0.99) << std::setw(10) << latencies.back() << std::endl;
+
+    // Destroying a process-shared condition that was used by other processes
+    // may block in pthread_cond_destroy; the area is re-created by the next run.
+    sharedMemory.release();
+}
+
+int32_t main(int32_t argc, char **argv) {
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    const uint32_t WIDTH{static_cast<uint32_t>((commandlineArguments.count("width") != 0) ? std::stoi(commandlineArguments["width"]) : 1920)};
+    const uint32_t HEIGHT{static_cast<uint32_t>((commandlineArguments.count("height") != 0) ? std::stoi(commandlineArguments["height"]) : 1200)};
+    const uint32_t FRAMES{static_cast<uint32_t>((commandlineArguments.count("frames") != 0) ? std::stoi(commandlineArguments["frames"]) : 500)};
+
+    std::cout << "Writer latency in us for publishing " << WIDTH << "x" << HEIGHT << " I420 frames (" << FRAMES << " frames per run)" << std::endl;
+    std::cout << "    mode  readers       p50       p99       max" << std::endl;
+    for (bool seqlock : {false, true}) {
+        for (uint32_t readers : {1, 4, 16}) {
+            // Every run uses a separate process to start from a fresh shared memory area.
+            const pid_t pid{fork()};
+            if (0 == pid) {
+                run(seqlock, readers, WIDTH, HEIGHT, FRAMES);
+                _exit(0);
+            }
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    {
+        // Remove the shared memory area of the last run.
+        cluon::SharedMemory cleanup{NAME, 1};
+    }
+    return 0;
+}
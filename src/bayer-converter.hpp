@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYER_CONVERTER_HPP
+#define BAYER_CONVERTER_HPP
+
+#include <libyuv.h>
+
+#include <cstdint>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+    #define BAYER_CONVERTER_X86_64
+    #include <immintrin.h>
+#endif
+
+/**
+ * Bilinear demosaicing of 8 bit Bayer frames into ARGB and I420.
+ *
+ * Every pixel takes its missing colors from the average of the nearest
+ * samples of that color: the vertical or horizontal pair for the red and
+ * blue samples next to a green site, and the cross or the diagonal
+ * neighbors at a red or blue site. The averages are computed as averages
+ * of pairwise averages, which the SIMD kernel and the scalar kernel both
+ * do identically. The borders are mirrored, keeping the Bayer phase.
+ *
+ * A pair of rows is demosaiced into ARGB (either directly into the ARGB
+ * frame or into a scratch buffer) and then converted into I420 while the
+ * ARGB rows are still in the cache.
+ */
+namespace bayer {
+
+/**
+ * Order of the colors in the top-left 2x2 block.
+ */
+enum class Pattern : uint8_t {
+    RGGB = 0,
+    BGGR = 1,
+    GRBG = 2,
+    GBRG = 3,
+};
+
+/**
+ * @return Parity of the rows holding red samples.
+ */
+inline uint32_t redRow(Pattern pattern) noexcept {
+    return ( (Pattern::RGGB == pattern) || (Pattern::GRBG == pattern) ) ? 0 : 1;
+}
+
+/**
+ * @return Parity of the columns holding red or blue samples in even rows.
+ */
+inline uint32_t colorColumn(Pattern pattern) noexcept {
+    return ( (Pattern::RGGB == pattern) || (Pattern::BGGR == pattern) ) ? 0 : 1;
+}
+
+inline uint8_t avg(uint32_t a, uint32_t b) noexcept {
+    return static_cast<uint8_t>((a + b + 1) >> 1);
+}
+
+/**
+ * Scalar kernel for the pixels [begin, end) of a row.
+ *
+ * @param above Row above (mirrored at the top border).
+ * @param row Row to demosaic.
+ * @param below Row below (mirrored at the bottom border).
+ * @param red true if the row holds red samples, false for blue samples.
+ * @param siteColumn Parity of the columns holding the red or blue samples.
+ * @param dstARGB ARGB row.
+ * @param width Width of the frame.
+ */
+inline void rowScalar(const uint8_t *above, const uint8_t *row, const uint8_t *below,
+                      bool red, uint32_t siteColumn, uint8_t *dstARGB,
+                      uint32_t width, uint32_t begin, uint32_t end) noexcept {
+    uint32_t *dst{reinterpret_cast<uint32_t*>(dstARGB)};
+    for (uint32_t x{begin}; x < end; x++) {
+        const uint32_t l{(0 < x) ? x - 1 : x + 1};
+        const uint32_t r{(x + 1 < width) ? x + 1 : x - 1};
+        const uint8_t vertical{avg(above[x], below[x])};
+        const uint8_t horizontal{avg(row[l], row[r])};
+        uint8_t color{0}, green{0}, other{0};
+        if ((x & 1) == siteColumn) {
+            color = row[x];
+            green = avg(vertical, horizontal);
+            other = avg(avg(above[l], above[r]), avg(below[l], below[r]));
+        }
+        else {
+            color = horizontal;
+            green = row[x];
+            other = vertical;
+        }
+        const uint32_t R{red ? color : other};
+        const uint32_t B{red ? other : color};
+        // ARGB is stored as little-endian 32-bit words, i.e., B, G, R, A in memory.
+        dst[x] = 0xFF000000u | (R << 16) | (static_cast<uint32_t>(green) << 8) | B;
+    }
+}
+
+#ifdef BAYER_CONVERTER_X86_64
+/**
+ * SSE2 kernel demosaicing 16 pixels per iteration, starting at pixel 16 to
+ * keep the neighbors inside the row; returns the first pixel that was not
+ * converted.
+ */
+inline uint32_t rowSSE2(const uint8_t *above, const uint8_t *row, const uint8_t *below,
+                        bool red, uint32_t siteColumn, uint8_t *dstARGB, uint32_t width) noexcept {
+    // Selects the red or blue sites within 16 pixels.
+    const __m128i SITE{(0 == siteColumn) ? _mm_set1_epi16(0x00FF) : _mm_set1_epi16(static_cast<int16_t>(0xFF00))};
+    const __m128i ALPHA{_mm_set1_epi8(static_cast<char>(0xFF))};
+    auto select = [&SITE](__m128i atSite, __m128i elsewhere) {
+        return _mm_or_si128(_mm_and_si128(SITE, atSite), _mm_andnot_si128(SITE, elsewhere));
+    };
+    auto load = [](const uint8_t *p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    };
+
+    uint32_t x{16};
+    for (; x + 17 <= width; x += 16) {
+        const __m128i center{load(row + x)};
+        const __m128i vertical{_mm_avg_epu8(load(above + x), load(below + x))};
+        const __m128i horizontal{_mm_avg_epu8(load(row + x - 1), load(row + x + 1))};
+        const __m128i cross{_mm_avg_epu8(vertical, horizontal)};
+        const __m128i diagonal{_mm_avg_epu8(_mm_avg_epu8(load(above + x - 1), load(above + x + 1)),
+                                            _mm_avg_epu8(load(below + x - 1), load(below + x + 1)))};
+
+        const __m128i color{select(center, horizontal)};
+        const __m128i g{select(cross, center)};
+        const __m128i other{select(diagonal, vertical)};
+        const __m128i r{red ? color : other};
+        const __m128i b{red ? other : color};
+
+        const __m128i bgLow{_mm_unpacklo_epi8(b, g)};
+        const __m128i bgHigh{_mm_unpackhi_epi8(b, g)};
+        const __m128i raLow{_mm_unpacklo_epi8(r, ALPHA)};
+        const __m128i raHigh{_mm_unpackhi_epi8(r, ALPHA)};
+        uint8_t *dst{dstARGB + x * 4};
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(bgLow, raLow));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(bgLow, raLow));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 32), _mm_unpacklo_epi16(bgHigh, raHigh));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 48), _mm_unpackhi_epi16(bgHigh, raHigh));
+    }
+    return x;
+}
+#endif
+
+/**
+ * @return Human-readable name of the kernel that is used on this CPU.
+ */
+inline const char *kernelName() noexcept {
+#ifdef BAYER_CONVERTER_X86_64
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+/**
+ * Demosaics row y of a Bayer frame into an ARGB row.
+ */
+inline void toARGBRow(const uint8_t *src, uint32_t srcStride, Pattern pattern,
+                      uint8_t *dstARGB, uint32_t width, uint32_t height, uint32_t y) noexcept {
+    const uint8_t *above{src + ((0 < y) ? y - 1 : y + 1) * srcStride};
+    const uint8_t *row{src + y * srcStride};
+    const uint8_t *below{src + ((y + 1 < height) ? y + 1 : y - 1) * srcStride};
+    const bool RED{(y & 1) == redRow(pattern)};
+    const uint32_t SITE_COLUMN{(y & 1) ^ colorColumn(pattern)};
+
+    const uint32_t HEAD{(16 < width) ? 16 : width};
+    rowScalar(above, row, below, RED, SITE_COLUMN, dstARGB, width, 0, HEAD);
+#ifdef BAYER_CONVERTER_X86_64
+    const uint32_t converted{rowSSE2(above, row, below, RED, SITE_COLUMN, dstARGB, width)};
+#else
+    const uint32_t converted{HEAD};
+#endif
+    rowScalar(above, row, below, RED, SITE_COLUMN, dstARGB, width, (converted > HEAD) ? converted : HEAD, width);
+}
+
+/**
+ * Demosaics the rows [beginRow, endRow) of a Bayer frame into I420 and,
+ * optionally, ARGB; beginRow and endRow must be even.
+ *
+ * @param src Bayer frame.
+ * @param srcStride Bytes per row of src.
+ * @param pattern Bayer pattern of src.
+ * @param dstY Y plane of the I420 frame (stride: width).
+ * @param dstU U plane of the I420 frame (stride: width/2).
+ * @param dstV V plane of the I420 frame (stride: width/2).
+ * @param dstARGB ARGB frame (stride: width*4) or nullptr to skip ARGB.
+ * @param scratch Two ARGB rows (width*8 bytes) used when dstARGB is nullptr.
+ * @param width Width of the frame; must be even.
+ * @param height Height of the frame; must be even as rows are converted in pairs.
+ * @param beginRow First row to convert; must be even.
+ * @param endRow Row after the last row to convert.
+ */
+inline void toI420AndARGB(const uint8_t *src, uint32_t srcStride, Pattern pattern,
+                          uint8_t *dstY, uint8_t *dstU, uint8_t *dstV, uint8_t *dstARGB, uint8_t *scratch,
+                          uint32_t width, uint32_t height, uint32_t beginRow, uint32_t endRow) noexcept {
+    const int W{static_cast<int>(width)};
+    for (uint32_t row{beginRow}; row < endRow; row += 2) {
+        uint8_t *argb{(nullptr != dstARGB) ? dstARGB + row * width * 4 : scratch};
+        toARGBRow(src, srcStride, pattern, argb, width, height, row);
+        toARGBRow(src, srcStride, pattern, argb + width * 4, width, height, row + 1);
+        libyuv::ARGBToI420(argb, W * 4,
+                           dstY + row * width, W,
+                           dstU + (row / 2) * (width / 2), W / 2,
+                           dstV + (row / 2) * (width / 2), W / 2,
+                           W, 2);
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAMERA_CLOCK_MODEL_HPP
+#define CAMERA_CLOCK_MODEL_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Maps the time stamps of a camera (in ticks of its clock) to host time.
+ *
+ * For every frame, the camera's time stamp and the time when the frame was
+ * received on the host are added as a sample. Offset and drift are fitted
+ * by linear regression over a sliding window of samples; samples whose
+ * residual deviates by more than three (scaled) median absolute deviations
+ * from the median residual, e.g., frames delayed on the host, are rejected
+ * and the fit is repeated on the remaining samples. The mapping is shifted
+ * to the lower envelope of the receive times such that a frame maps to the
+ * host time at which it would have been received with the smallest
+ * observed delay; the receive jitter around the fit is reported as RMS and
+ * maximum residual.
+ *
+ * The model works with any tick frequency and hence, also when the camera
+ * is not synchronized via PTP. It resets itself when the camera's clock
+ * goes backwards or when several consecutive samples are far off the fit,
+ * i.e., when the clock jumped (e.g., when PTP locks), and can be reset
+ * explicitly. A single frame far off, e.g., delayed on the host, is mapped
+ * but not added to the fit.
+ */
+class CameraClockModel {
+   public:
+    static constexpr uint32_t MIN_SAMPLES{16};
+    // Samples farther off than this are not added to the fit; as many
+    // consecutive ones as MAX_DEVIATIONS restart the model.
+    static constexpr double MAX_DEVIATION_IN_MICROSECONDS{100000.0};
+    static constexpr uint32_t MAX_DEVIATIONS{5};
+
+    struct Sample {
+        double ticks{0};
+        double hostTimeInMicroseconds{0};
+    };
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param window Number of samples to fit the model to.
+     */
+    explicit CameraClockModel(uint32_t window) noexcept
+        : m_samples((window > MIN_SAMPLES) ? window : MIN_SAMPLES) {
+        m_use.reserve(m_samples.size());
+        m_residuals.reserve(m_samples.size());
+        m_scratch.reserve(m_samples.size());
+    }
+
+    void reset() noexcept {
+        m_count = 0;
+        m_next = 0;
+        m_deviations = 0;
+        m_valid = false;
+        m_resets++;
+    }
+
+    /**
+     * Adds a sample and refits the model.
+     *
+     * @param ticks Time stamp of the frame from the camera.
+     * @param hostTimeInMicroseconds Time when the frame was received on the host.
+     */
+    void addSample(uint64_t ticks, int64_t hostTimeInMicroseconds) noexcept {
+        const bool DEVIATES{m_valid && (0 < m_count) && (ticks >= m_lastTicks) &&
+                            (MAX_DEVIATION_IN_MICROSECONDS < std::fabs(static_cast<double>(hostTimeInMicroseconds - toHost(ticks))))};
+        m_deviations = DEVIATES ? m_deviations + 1 : 0;
+        if (DEVIATES && (MAX_DEVIATIONS > m_deviations)) {
+            m_lastTicks = ticks;
+            return;
+        }
+        if ( (0 == m_count) || (ticks < m_lastTicks) || DEVIATES ) {
+            if (0 < m_count) {
+                reset();
+            }
+            m_referenceTicks = ticks;
+            m_referenceHostTime = hostTimeInMicroseconds;
+        }
+        m_lastTicks = ticks;
+
+        Sample &s{m_samples[m_next]};
+        s.ticks = static_cast<double>(ticks - m_referenceTicks);
+        s.hostTimeInMicroseconds = static_cast<double>(hostTimeInMicroseconds - m_referenceHostTime);
+        m_next = (m_next + 1) % static_cast<uint32_t>(m_samples.size());
+        m_count = std::min(m_count + 1, static_cast<uint32_t>(m_samples.size()));
+
+        if (MIN_SAMPLES <= m_count) {
+            fit();
+        }
+    }
+
+    /**
+     * @return true if enough samples were collected to map time stamps.
+     */
+    bool isValid() const noexcept {
+        return m_valid;
+    }
+
+    /**
+     * @return Host time in microseconds for the given camera time stamp.
+     */
+    int64_t toHost(uint64_t ticks) const noexcept {
+        const double x{static_cast<double>(static_cast<int64_t>(ticks - m_referenceTicks))};
+        return m_referenceHostTime + static_cast<int64_t>(std::llround(m_slope * x + m_intercept));
+    }
+
+    /**
+     * @return Estimated frequency of the camera's clock in ticks per microsecond.
+     */
+    double ticksPerMicrosecond() const noexcept {
+        return (0.0 < m_slope) ? 1.0 / m_slope : 0.0;
+    }
+
+    double residualRMSInMicroseconds() const noexcept {
+        return m_residualRMS;
+    }
+
+    double residualMaxInMicroseconds() const noexcept {
+        return m_residualMax;
+    }
+
+    uint32_t inliers() const noexcept {
+        return m_inliers;
+    }
+
+    uint32_t samples() const noexcept {
+        return m_count;
+    }
+
+    uint64_t resets() const noexcept {
+        return m_resets;
+    }
+
+   private:
+    bool regression(const std::vector<bool> &use, double &slope, double &intercept) const noexcept {
+        double n{0}, sx{0}, sy{0};
+        for (uint32_t i{0}; i < m_count; i++) {
+            if (use[i]) {
+                n += 1;
+                sx += m_samples[i].ticks;
+                sy += m_samples[i].hostTimeInMicroseconds;
+            }
+        }
+        if (2 > n) {
+            return false;
+        }
+        const double MX{sx / n};
+        const double MY{sy / n};
+        double sxx{0}, sxy{0};
+        for (uint32_t i{0}; i < m_count; i++) {
+            if (use[i]) {
+                const double DX{m_samples[i].ticks - MX};
+                sxx += DX * DX;
+                sxy += DX * (m_samples[i].hostTimeInMicroseconds - MY);
+            }
+        }
+        if (0.0 >= sxx) {
+            return false;
+        }
+        slope = sxy / sxx;
+        intercept = MY - slope * MX;
+        return true;
+    }
+
+    void fit() noexcept {
+        std::vector<bool> &use{m_use};
+        use.assign(m_count, true);
+        double slope{0}, intercept{0};
+        if (!regression(use, slope, intercept)) {
+            return;
+        }
+
+        // Reject outliers by the median absolute deviation of the residuals.
+        m_residuals.resize(m_count);
+        for (uint32_t i{0}; i < m_count; i++) {
+            m_residuals[i] = m_samples[i].hostTimeInMicroseconds - (slope * m_samples[i].ticks + intercept);
+        }
+        m_scratch = m_residuals;
+        std::nth_element(m_scratch.begin(), m_scratch.begin() + m_count / 2, m_scratch.end());
+        const double MEDIAN{m_scratch[m_count / 2]};
+        for (auto &r : m_scratch) {
+            r = std::fabs(r - MEDIAN);
+        }
+        std::nth_element(m_scratch.begin(), m_scratch.begin() + m_count / 2, m_scratch.end());
+        // Keep a floor to not reject samples of a (nearly) jitter-free clock.
+        const double LIMIT{std::max(3.0 * 1.4826 * m_scratch[m_count / 2], 1.0)};
+        for (uint32_t i{0}; i < m_count; i++) {
+            use[i] = (std::fabs(m_residuals[i] - MEDIAN) <= LIMIT);
+        }
+        if (!regression(use, slope, intercept)) {
+            return;
+        }
+
+        double minimum{0}, sumOfSquares{0}, maximum{0};
+        uint32_t inliers{0};
+        for (uint32_t i{0}; i < m_count; i++) {
+            if (use[i]) {
+                const double R{m_samples[i].hostTimeInMicroseconds - (slope * m_samples[i].ticks + intercept)};
+                minimum = (0 == inliers) ? R : std::min(minimum, R);
+                sumOfSquares += R * R;
+                maximum = std::max(maximum, std::fabs(R));
+                inliers++;
+            }
+        }
+        m_slope = slope;
+        m_intercept = intercept + minimum;
+        m_residualRMS = std::sqrt(sumOfSquares / inliers);
+        m_residualMax = maximum;
+        m_inliers = inliers;
+        m_valid = true;
+    }
+
+   private:
+    std::vector<Sample> m_samples{};
+    std::vector<double> m_residuals{};
+    std::vector<double> m_scratch{};
+    std::vector<bool> m_use{};
+    uint32_t m_count{0};
+    uint32_t m_deviations{0};
+    uint32_t m_next{0};
+    uint64_t m_referenceTicks{0};
+    int64_t m_referenceHostTime{0};
+    uint64_t m_lastTicks{0};
+
+    bool m_valid{false};
+    double m_slope{0};
+    double m_intercept{0};
+    double m_residualRMS{0};
+    double m_residualMax{0};
+    uint32_t m_inliers{0};
+    uint64_t m_resets{0};
+};
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLIGHT_RECORDER_HPP
+#define FLIGHT_RECORDER_HPP
+
+#include "packed-pixels.hpp"
+#include "realtime.hpp"
+#include "rec-file.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Ring of the latest raw frames in memory that is written to a .rec file
+ * (see RecFile) on request.
+ *
+ * The ring is mapped and faulted in once; keep() copies every frame into the
+ * next slot, overwriting the oldest one, and never waits. A dump is done by a
+ * separate thread while frames keep arriving: it writes the frames that were
+ * in the ring when the dump was requested from the oldest to the newest.
+ * Requests are counted in an atomic counter that a signal handler can
+ * increment; the dump thread polls it, so a dump does not depend on frames
+ * still arriving from the camera.
+ * Every slot carries a sequence number that is odd while the slot is written
+ * (seqlock); a frame that was overwritten while it was being copied out is
+ * skipped and counted. Packed 10 and 12 bit frames are kept as received and
+ * unpacked into 16 bit per sample while they are written.
+ */
+class FlightRecorder {
+   private:
+    FlightRecorder(const FlightRecorder &) = delete;
+    FlightRecorder(FlightRecorder &&)      = delete;
+    FlightRecorder &operator=(const FlightRecorder &) = delete;
+    FlightRecorder &operator=(FlightRecorder &&) = delete;
+
+   private:
+    struct Slot {
+        // 2n+1 while frame n is written, 2n+2 when it is complete.
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<int64_t> sampleTimeStampInMicroseconds{0};
+        std::atomic<int64_t> receivedInMicroseconds{0};
+    };
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param prefix Path and name prefix of the .rec files to dump to.
+     * @param fourcc Format of the frames in the .rec file, e.g., "YUYV".
+     * @param width Width of the frames.
+     * @param height Height of the frames.
+     * @param frameSize Size of a frame in bytes as received.
+     * @param packedBits Bits per sample of packed frames to unpack; 0 to write the frames as received.
+     * @param senderStamp Sender stamp of the Envelopes.
+     * @param slots Number of frames to keep.
+     * @param requests Counter of dump requests; every change starts a dump.
+     */
+    FlightRecorder(const std::string &prefix, const std::string &fourcc, uint32_t width, uint32_t height, uint32_t frameSize, uint32_t packedBits, uint32_t senderStamp, uint32_t slots, const std::atomic<uint32_t> &requests) noexcept
+        : m_prefix{prefix}
+        , m_fourcc{fourcc}
+        , m_width{width}
+        , m_height{height}
+        , m_frameSize{frameSize}
+        , m_packedBits{packedBits}
+        , m_recordedSize{(0 < packedBits) ? width * height * static_cast<uint32_t>(sizeof(uint16_t)) : frameSize}
+        , m_senderStamp{senderStamp}
+        , m_numberOfSlots{std::max<uint32_t>(1, slots)}
+        , m_ring{static_cast<std::size_t>(frameSize) * std::max<uint32_t>(1, slots)}
+        , m_slots{new Slot[std::max<uint32_t>(1, slots)]}
+        , m_requests{requests}
+        , m_servedRequests{requests.load()} {
+        if (m_ring.valid() && (RecFile::MAX_ENVELOPE_SIZE >= RecFile::envelopeSize(fourcc, width, height, m_recordedSize, senderStamp, 0, 0) + 3 * 8)) {
+            m_dumper = std::thread(&FlightRecorder::run, this);
+        }
+    }
+
+    ~FlightRecorder() {
+        // A pending dump is written before the dump thread stops.
+        {
+            std::lock_guard<std::mutex> lck(m_dumpMutex);
+            m_stop = true;
+        }
+        m_dumpCondition.notify_all();
+        if (m_dumper.joinable()) {
+            m_dumper.join();
+        }
+    }
+
+    /**
+     * @return true if the ring is mapped and the dump thread is running.
+     */
+    bool valid() const noexcept {
+        return m_dumper.joinable();
+    }
+
+    /**
+     * @return true if the ring is locked into RAM.
+     */
+    bool locked() const noexcept {
+        return m_ring.locked();
+    }
+
+    std::size_t size() const noexcept {
+        return m_ring.size();
+    }
+
+    uint32_t capacity() const noexcept {
+        return m_numberOfSlots;
+    }
+
+    /**
+     * Copies the frame into the ring; called from one thread only.
+     */
+    void keep(const char *frame, int64_t sampleTimeStampInMicroseconds, int64_t receivedInMicroseconds) noexcept {
+        if (!valid()) {
+            return;
+        }
+        const uint64_t FRAME{m_frames.load(std::memory_order_relaxed)};
+        Slot &slot{m_slots[FRAME % m_numberOfSlots]};
+        slot.sequence.store(2 * FRAME + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(m_ring.data() + (FRAME % m_numberOfSlots) * m_frameSize, frame, m_frameSize);
+        slot.sampleTimeStampInMicroseconds.store(sampleTimeStampInMicroseconds, std::memory_order_relaxed);
+        slot.receivedInMicroseconds.store(receivedInMicroseconds, std::memory_order_relaxed);
+        slot.sequence.store(2 * FRAME + 2, std::memory_order_release);
+        m_frames.store(FRAME + 1, std::memory_order_release);
+    }
+
+    /**
+     * Requests to dump the ring; never waits. Requests during a dump are
+     * served by one more dump afterwards. Not async-signal-safe; signal
+     * handlers increment the counter given to the constructor instead.
+     */
+    void dump() noexcept {
+        {
+            std::lock_guard<std::mutex> lck(m_dumpMutex);
+            m_dumpRequested = true;
+        }
+        m_dumpCondition.notify_all();
+    }
+
+    /**
+     * @return Number of completed dumps.
+     */
+    uint64_t dumps() const noexcept {
+        return m_dumps.load(std::memory_order_relaxed);
+    }
+
+   private:
+    void run() noexcept {
+        std::vector<char> frame(m_frameSize);
+        std::vector<uint16_t> unpacked((0 < m_packedBits) ? static_cast<std::size_t>(m_width) * m_height : 0);
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lck(m_dumpMutex);
+                m_dumpCondition.wait_for(lck, std::chrono::milliseconds(100), [this]() { return m_stop || m_dumpRequested || (m_servedRequests != m_requests.load()); });
+                if (m_servedRequests != m_requests.load()) {
+                    m_servedRequests = m_requests.load();
+                    m_dumpRequested = true;
+                }
+                if (!m_dumpRequested) {
+                    if (m_stop) {
+                        break;
+                    }
+                    continue;
+                }
+                m_dumpRequested = false;
+            }
+
+            const auto start{std::chrono::steady_clock::now()};
+            const uint64_t NEWEST{m_frames.load(std::memory_order_acquire)};
+            if (0 == NEWEST) {
+                std::clog << "[opendlv-device-camera-pylon]: Flight recorder has no frames to dump." << std::endl;
+                continue;
+            }
+            const uint64_t OLDEST{(NEWEST > m_numberOfSlots) ? NEWEST - m_numberOfSlots : 0};
+            const std::string FILENAME{m_prefix + "-" + now() + "-" + std::to_string(m_dumps.load(std::memory_order_relaxed)) + ".rec"};
+            uint64_t written{0}, overwritten{0};
+            int64_t first{0}, last{0};
+            {
+                RecFile file{FILENAME};
+                if (!file.valid()) {
+                    std::cerr << "[opendlv-device-camera-pylon]: Failed to create '" << FILENAME << "' for the flight recorder." << std::endl;
+                    continue;
+                }
+                for (uint64_t n{OLDEST}; n < NEWEST; n++) {
+                    Slot &slot{m_slots[n % m_numberOfSlots]};
+                    const uint64_t SEQUENCE{slot.sequence.load(std::memory_order_acquire)};
+                    if (2 * n + 2 != SEQUENCE) {
+                        overwritten++;
+                        continue;
+                    }
+                    std::memcpy(frame.data(), m_ring.data() + (n % m_numberOfSlots) * m_frameSize, m_frameSize);
+                    const int64_t SAMPLE{slot.sampleTimeStampInMicroseconds.load(std::memory_order_relaxed)};
+                    const int64_t RECEIVED{slot.receivedInMicroseconds.load(std::memory_order_relaxed)};
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (SEQUENCE != slot.sequence.load(std::memory_order_relaxed)) {
+                        // Overwritten by a new frame while copying.
+                        overwritten++;
+                        continue;
+                    }
+                    if (0 < m_packedBits) {
+                        const uint32_t STRIDE{m_width * m_packedBits / 8};
+                        for (uint32_t row{0}; row < m_height; row++) {
+                            packed::unpackRow(reinterpret_cast<const uint8_t*>(frame.data()) + row * STRIDE, m_packedBits, unpacked.data() + static_cast<std::size_t>(row) * m_width, m_width);
+                        }
+                        file.write(m_fourcc, m_width, m_height, reinterpret_cast<const char*>(unpacked.data()), m_recordedSize, m_senderStamp, SAMPLE, RECEIVED);
+                    }
+                    else {
+                        file.write(m_fourcc, m_width, m_height, frame.data(), m_frameSize, m_senderStamp, SAMPLE, RECEIVED);
+                    }
+                    first = (0 == written) ? SAMPLE : first;
+                    last = SAMPLE;
+                    written++;
+                }
+            }
+            m_dumps.fetch_add(1, std::memory_order_relaxed);
+            std::clog << "[opendlv-device-camera-pylon]: Flight recorder dumped " << written << " frames (" << (last - first) / 1000 << " ms) to '" << FILENAME << "' in " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms; " << overwritten << " frames were overwritten before they were written." << std::endl;
+        }
+    }
+
+    static std::string now() noexcept {
+        const std::time_t NOW{std::time(nullptr)};
+        std::tm tm{};
+        char buffer[32]{};
+        localtime_r(&NOW, &tm);
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d_%H%M%S", &tm);
+        return buffer;
+    }
+
+   private:
+    std::string m_prefix;
+    std::string m_fourcc;
+    uint32_t m_width{0};
+    uint32_t m_height{0};
+    uint32_t m_frameSize{0};
+    uint32_t m_packedBits{0};
+    uint32_t m_recordedSize{0};
+    uint32_t m_senderStamp{0};
+    uint32_t m_numberOfSlots{0};
+
+    realtime::LockedMemory m_ring;
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<uint64_t> m_frames{0};
+    std::atomic<uint64_t> m_dumps{0};
+    const std::atomic<uint32_t> &m_requests;
+    uint32_t m_servedRequests{0};
+
+    std::mutex m_dumpMutex{};
+    std::condition_variable m_dumpCondition{};
+    bool m_dumpRequested{false};
+    bool m_stop{false};
+    std::thread m_dumper{};
+};
+
+#endif
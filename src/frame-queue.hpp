@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_QUEUE_HPP
+#define FRAME_QUEUE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/**
+ * Bounded lock-free queue to hand over grabbed frames from the grab thread
+ * (producer) to the conversion thread (consumer).
+ *
+ * The ring follows Vyukov's design with one sequence number per cell. The
+ * handover itself never takes a lock; the producer is allowed to act as a
+ * second consumer to evict the oldest entry when the queue is full and the
+ * overflow policy is DROP_OLDEST. The mutex/condition variable pairs are
+ * only used to put an idle consumer or, with BLOCK, a producer facing a full
+ * queue to sleep; a sleeping party announces itself in an atomic flag before
+ * checking the queue once more, and the other side only takes the mutex to
+ * notify when the flag is set.
+ */
+template <typename T>
+class FrameQueue {
+   private:
+    FrameQueue(const FrameQueue &) = delete;
+    FrameQueue(FrameQueue &&)      = delete;
+    FrameQueue &operator=(const FrameQueue &) = delete;
+    FrameQueue &operator=(FrameQueue &&) = delete;
+
+   public:
+    enum class OverflowPolicy : uint8_t {
+        DROP_OLDEST = 0,
+        BLOCK       = 1,
+    };
+
+   private:
+    struct Cell {
+        std::atomic<std::size_t> sequence{0};
+        T data{};
+    };
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param capacity Number of entries; rounded up to the next power of two.
+     * @param policy Behavior of push() when the queue is full.
+     */
+    FrameQueue(std::size_t capacity, OverflowPolicy policy) noexcept
+        : m_policy{policy} {
+        m_capacity = 1;
+        while (m_capacity < capacity) {
+            m_capacity <<= 1;
+        }
+        m_mask = m_capacity - 1;
+        m_cells.reset(new Cell[m_capacity]);
+        for (std::size_t i{0}; i < m_capacity; i++) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Enqueues an entry; called from the producer only.
+     *
+     * @param entry to enqueue.
+     * @return false if the queue was closed before the entry could be placed.
+     */
+    bool push(T &&entry) noexcept {
+        while (!tryPush(std::move(entry))) {
+            if (m_closed.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (OverflowPolicy::DROP_OLDEST == m_policy) {
+                T oldest;
+                if (tryPop(oldest)) {
+                    m_drops.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            else {
+                std::unique_lock<std::mutex> lck(m_notFullMutex);
+                m_producerWaiting.store(true);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                m_notFullCondition.wait(lck, [this]() {
+                    return !isFull() || m_closed.load(std::memory_order_acquire);
+                });
+                m_producerWaiting.store(false, std::memory_order_relaxed);
+            }
+        }
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+
+        const std::size_t currentDepth{depth()};
+        std::size_t previousMaxDepth{m_maxDepth.load(std::memory_order_relaxed)};
+        while ( (currentDepth > previousMaxDepth) &&
+                !m_maxDepth.compare_exchange_weak(previousMaxDepth, currentDepth, std::memory_order_relaxed) ) {}
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (0 < m_consumersWaiting.load()) {
+            // Taking the mutex guarantees that a consumer that just found the
+            // queue empty is already waiting before we notify it.
+            {
+                std::lock_guard<std::mutex> lck(m_waitMutex);
+            }
+            m_waitCondition.notify_one();
+        }
+        return true;
+    }
+
+    /**
+     * Dequeues the oldest entry; waits up to timeout for an entry to arrive.
+     *
+     * @param entry to receive the dequeued data.
+     * @param timeout to wait for new data.
+     * @return true if an entry was dequeued.
+     */
+    bool pop(T &entry, std::chrono::milliseconds timeout) noexcept {
+        if (tryPop(entry)) {
+            return true;
+        }
+        bool retVal{false};
+        std::unique_lock<std::mutex> lck(m_waitMutex);
+        // The queue is checked again after announcing the wait; a producer
+        // either sees the announcement or its entry is found here.
+        m_consumersWaiting.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        m_waitCondition.wait_for(lck, timeout, [this, &entry, &retVal](){
+            retVal = tryPop(entry);
+            return retVal || m_closed.load(std::memory_order_acquire);
+        });
+        m_consumersWaiting.fetch_sub(1, std::memory_order_relaxed);
+        return retVal;
+    }
+
+    /**
+     * Dequeues the oldest entry if there is one; never waits or takes a lock
+     * (unless a producer waits for a free cell with BLOCK).
+     *
+     * @param entry to receive the dequeued data.
+     * @return true if an entry was dequeued.
+     */
+    bool tryPop(T &entry) noexcept {
+        std::size_t position{m_dequeuePosition.load(std::memory_order_relaxed)};
+        for (;;) {
+            Cell &cell{m_cells[position & m_mask]};
+            const std::size_t sequence{cell.sequence.load(std::memory_order_acquire)};
+            const intptr_t difference{static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1)};
+            if (0 == difference) {
+                if (m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    entry = std::move(cell.data);
+                    cell.data = T{};
+                    cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+                    notifyProducer();
+                    return true;
+                }
+            }
+            else if (0 > difference) {
+                return false;
+            }
+            else {
+                position = m_dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Wakes up all waiting parties and rejects further entries.
+     */
+    void close() noexcept {
+        m_closed.store(true, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lck(m_waitMutex);
+        }
+        m_waitCondition.notify_all();
+        {
+            std::lock_guard<std::mutex> lck(m_notFullMutex);
+        }
+        m_notFullCondition.notify_all();
+    }
+
+    /**
+     * @return Approximate number of entries currently enqueued.
+     */
+    std::size_t depth() const noexcept {
+        const std::size_t enqueued{m_enqueuePosition.load(std::memory_order_relaxed)};
+        const std::size_t dequeued{m_dequeuePosition.load(std::memory_order_relaxed)};
+        return (enqueued > dequeued) ? (enqueued - dequeued) : 0;
+    }
+
+    std::size_t capacity() const noexcept {
+        return m_capacity;
+    }
+
+    std::size_t maxDepth() const noexcept {
+        return m_maxDepth.load(std::memory_order_relaxed);
+    }
+
+    uint64_t drops() const noexcept {
+        return m_drops.load(std::memory_order_relaxed);
+    }
+
+    uint64_t pushed() const noexcept {
+        return m_pushed.load(std::memory_order_relaxed);
+    }
+
+   private:
+    bool tryPush(T &&entry) noexcept {
+        std::size_t position{m_enqueuePosition.load(std::memory_order_relaxed)};
+        for (;;) {
+            Cell &cell{m_cells[position & m_mask]};
+            const std::size_t sequence{cell.sequence.load(std::memory_order_acquire)};
+            const intptr_t difference{static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position)};
+            if (0 == difference) {
+                if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.data = std::move(entry);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (0 > difference) {
+                return false;
+            }
+            else {
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool isFull() const noexcept {
+        const std::size_t position{m_enqueuePosition.load(std::memory_order_relaxed)};
+        const std::size_t sequence{m_cells[position & m_mask].sequence.load(std::memory_order_acquire)};
+        return 0 > static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+    }
+
+    // Wakes up a producer waiting for a free cell with BLOCK.
+    void notifyProducer() noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_producerWaiting.load(std::memory_order_relaxed)) {
+            {
+                std::lock_guard<std::mutex> lck(m_notFullMutex);
+            }
+            m_notFullCondition.notify_one();
+        }
+    }
+
+   private:
+    OverflowPolicy m_policy;
+    std::size_t m_capacity{0};
+    std::size_t m_mask{0};
+    std::unique_ptr<Cell[]> m_cells{nullptr};
+
+    // Keep the producer and consumer positions on separate cache lines.
+    std::atomic<std::size_t> m_enqueuePosition{0};
+    char m_paddingEnqueuePosition[64 - sizeof(std::atomic<std::size_t>)]{};
+    std::atomic<std::size_t> m_dequeuePosition{0};
+    char m_paddingDequeuePosition[64 - sizeof(std::atomic<std::size_t>)]{};
+
+    std::atomic<bool> m_closed{false};
+    std::atomic<std::size_t> m_maxDepth{0};
+    std::atomic<uint64_t> m_drops{0};
+    std::atomic<uint64_t> m_pushed{0};
+
+    std::atomic<uint32_t> m_consumersWaiting{0};
+    std::mutex m_waitMutex{};
+    std::condition_variable m_waitCondition{};
+
+    std::atomic<bool> m_producerWaiting{false};
+    std::mutex m_notFullMutex{};
+    std::condition_variable m_notFullCondition{};
+};
+
+#endif
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_RECORDER_HPP
+#define FRAME_RECORDER_HPP
+
+#include "frame-queue.hpp"
+#include "rec-file.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Writes frames as opendlv.proxy.ImageReading into a .rec file (see RecFile)
+ * from a background thread.
+ *
+ * The producer copies a frame into one of a fixed number of slots and hands
+ * the slot over to the writer; if no slot is free because the disk cannot
+ * keep up, the frame is dropped and counted instead of waiting.
+ */
+class FrameRecorder {
+   private:
+    FrameRecorder(const FrameRecorder &) = delete;
+    FrameRecorder(FrameRecorder &&)      = delete;
+    FrameRecorder &operator=(const FrameRecorder &) = delete;
+    FrameRecorder &operator=(FrameRecorder &&) = delete;
+
+   private:
+    struct RecordedFrame {
+        uint32_t slot{0};
+        int64_t sampleTimeStampInMicroseconds{0};
+        int64_t sentInMicroseconds{0};
+    };
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param filename .rec file to create (an existing file is replaced).
+     * @param fourcc Format of the frames, e.g., "I420".
+     * @param width Width of the frames.
+     * @param height Height of the frames.
+     * @param frameSize Size of a frame in bytes.
+     * @param senderStamp Sender stamp of the Envelopes.
+     * @param slots Number of frames to buffer for the writer.
+     */
+    FrameRecorder(const std::string &filename, const std::string &fourcc, uint32_t width, uint32_t height, uint32_t frameSize, uint32_t senderStamp, uint32_t slots) noexcept
+        : m_fourcc{fourcc}
+        , m_width{width}
+        , m_height{height}
+        , m_frameSize{frameSize}
+        , m_senderStamp{senderStamp}
+        , m_slots(static_cast<std::size_t>(frameSize) * std::max<uint32_t>(1, slots))
+        , m_free{std::max<uint32_t>(1, slots), FrameQueue<uint32_t>::OverflowPolicy::BLOCK}
+        , m_ready{std::max<uint32_t>(1, slots), FrameQueue<RecordedFrame>::OverflowPolicy::BLOCK}
+        , m_file{filename} {
+        // Each of the three time stamps takes at most 8 bytes more than at 0.
+        if ( !m_file.valid() || (RecFile::MAX_ENVELOPE_SIZE < RecFile::envelopeSize(fourcc, width, height, frameSize, senderStamp, 0, 0) + 3 * 8) ) {
+            return;
+        }
+        for (uint32_t slot{0}; slot < std::max<uint32_t>(1, slots); slot++) {
+            m_free.push(std::move(slot));
+        }
+        m_writer = std::thread(&FrameRecorder::write, this);
+    }
+
+    ~FrameRecorder() {
+        // Frames that are still queued are written before the writer stops.
+        m_stop.store(true, std::memory_order_release);
+        m_ready.close();
+        if (m_writer.joinable()) {
+            m_writer.join();
+        }
+    }
+
+    /**
+     * @return true if the file is open and the writer is running.
+     */
+    bool valid() const noexcept {
+        return m_writer.joinable();
+    }
+
+    /**
+     * Copies the frame for the writer; never waits for the disk.
+     *
+     * @param frame Frame of frameSize bytes.
+     * @param sampleTimeStampInMicroseconds Sample time stamp of the frame.
+     * @param sentInMicroseconds Time stamp for sent and received.
+     * @return false if the frame was dropped because all slots are in use.
+     */
+    bool record(const char *frame, int64_t sampleTimeStampInMicroseconds, int64_t sentInMicroseconds) noexcept {
+        uint32_t slot{0};
+        if (!valid() || !m_free.tryPop(slot)) {
+            m_drops.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::memcpy(m_slots.data() + static_cast<std::size_t>(slot) * m_frameSize, frame, m_frameSize);
+        RecordedFrame recordedFrame;
+        recordedFrame.slot = slot;
+        recordedFrame.sampleTimeStampInMicroseconds = sampleTimeStampInMicroseconds;
+        recordedFrame.sentInMicroseconds = sentInMicroseconds;
+        m_ready.push(std::move(recordedFrame));
+        return true;
+    }
+
+    uint64_t frames() const noexcept {
+        return m_frames.load(std::memory_order_relaxed);
+    }
+
+    uint64_t drops() const noexcept {
+        return m_drops.load(std::memory_order_relaxed);
+    }
+
+    uint64_t bytes() const noexcept {
+        return m_file.bytes();
+    }
+
+    uint64_t failedWrites() const noexcept {
+        return m_file.failedWrites();
+    }
+
+    /**
+     * @return Bytes per second while writing to the disk.
+     */
+    double throughput() const noexcept {
+        return m_file.throughput();
+    }
+
+    std::size_t depth() const noexcept {
+        return m_ready.depth();
+    }
+
+    std::size_t maxDepth() const noexcept {
+        return m_ready.maxDepth();
+    }
+
+    std::size_t capacity() const noexcept {
+        return m_slots.size() / m_frameSize;
+    }
+
+    /**
+     * @return true while the file is written without the page cache.
+     */
+    bool direct() const noexcept {
+        return m_file.direct();
+    }
+
+   private:
+    void write() noexcept {
+        RecordedFrame recordedFrame;
+        for (;;) {
+            if (!m_ready.pop(recordedFrame, std::chrono::milliseconds(100))) {
+                if (m_stop.load(std::memory_order_acquire)) {
+                    break;
+                }
+                continue;
+            }
+            const bool WRITTEN{m_file.write(m_fourcc, m_width, m_height, m_slots.data() + static_cast<std::size_t>(recordedFrame.slot) * m_frameSize, m_frameSize, m_senderStamp, recordedFrame.sampleTimeStampInMicroseconds, recordedFrame.sentInMicroseconds)};
+            m_free.push(std::move(recordedFrame.slot));
+            if (WRITTEN) {
+                m_frames.fetch_add(1, std::memory_order_relaxed);
+            }
+            else {
+                m_drops.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+   private:
+    std::string m_fourcc;
+    uint32_t m_width{0};
+    uint32_t m_height{0};
+    uint32_t m_frameSize{0};
+    uint32_t m_senderStamp{0};
+
+    std::vector<char> m_slots;
+    FrameQueue<uint32_t> m_free;
+    FrameQueue<RecordedFrame> m_ready;
+    RecFile m_file;
+
+    std::atomic<uint64_t> m_frames{0};
+    std::atomic<uint64_t> m_drops{0};
+    std::atomic<bool> m_stop{false};
+    std::thread m_writer{};
+};
+
+#endif
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SET_ASSEMBLER_HPP
+#define FRAME_SET_ASSEMBLER_HPP
+
+#include "shared-memory-layout.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+/**
+ * Groups the frames of several cameras whose time stamps are within a
+ * tolerance into sets in a FrameSetHeader-based shared memory area.
+ *
+ * Up to MAX_OPEN_SETS sets are assembled at the same time so that cameras
+ * which are free-running or slightly out of phase still end up in matched
+ * sets. A frame joins the open set with the nearest time stamp within the
+ * tolerance that its camera has not contributed to yet, or otherwise opens
+ * a new set. An open set is only abandoned as incomplete once a camera that
+ * is still missing delivered a frame newer than the set's time stamp plus
+ * the tolerance, when a newer set was completed, or when the window is full
+ * and the set is the oldest one. A frame that matches no set and is older
+ * than the latest complete set is counted as late and ignored. The frames
+ * are copied by the calling camera threads in parallel; the mutex is only
+ * held to book-keep the slots.
+ */
+class FrameSetAssembler {
+   private:
+    FrameSetAssembler(const FrameSetAssembler &) = delete;
+    FrameSetAssembler(FrameSetAssembler &&)      = delete;
+    FrameSetAssembler &operator=(const FrameSetAssembler &) = delete;
+    FrameSetAssembler &operator=(FrameSetAssembler &&) = delete;
+
+   public:
+    /**
+     * Number of sets assembled at the same time; the area needs
+     * MAX_OPEN_SETS + 1 + cameras slots for these, the latest complete set,
+     * and abandoned sets that camera threads are still copying into.
+     */
+    static constexpr uint32_t MAX_OPEN_SETS{3};
+
+   private:
+    struct OpenSet {
+        int32_t slot{-1};
+        uint64_t set{0};
+        int64_t timeStamp{0};
+        uint32_t present{0};
+        uint32_t copied{0};
+    };
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param header Initialized layout of the shared memory area.
+     * @param onPublish Called after a set was completed, e.g., to notify readers.
+     */
+    FrameSetAssembler(FrameSetHeader *header, std::function<void()> onPublish) noexcept
+        : m_header{header}
+        , m_onPublish{onPublish}
+        , m_pendingCopies(header->slotCount, 0)
+        , m_lastTimeStamps(header->cameraCount, std::numeric_limits<int64_t>::min())
+        , m_allCameras{(1u << header->cameraCount) - 1} {}
+
+    /**
+     * Adds the frame of a camera to the matching set.
+     *
+     * @param camera Index of the camera.
+     * @param sampleTimeStamp Sample time stamp of the frame in microseconds.
+     * @param frame I420 frame of the camera.
+     */
+    void offer(uint32_t camera, int64_t sampleTimeStamp, const char *frame) noexcept {
+        const uint32_t BIT{1u << camera};
+        const int64_t TOLERANCE{m_header->toleranceInMicroseconds};
+        int32_t slot{-1};
+        uint64_t set{0};
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_lastTimeStamps[camera] = std::max(m_lastTimeStamps[camera], sampleTimeStamp);
+            evictStaleSets(TOLERANCE);
+
+            OpenSet *match{nullptr};
+            for (auto &openSet : m_openSets) {
+                if ( (0 <= openSet.slot) && (0 == (openSet.present & BIT)) &&
+                     (std::abs(sampleTimeStamp - openSet.timeStamp) <= TOLERANCE) &&
+                     ( (nullptr == match) || (std::abs(sampleTimeStamp - openSet.timeStamp) < std::abs(sampleTimeStamp - match->timeStamp)) ) ) {
+                    match = &openSet;
+                }
+            }
+            if ( (nullptr == match) && (0 < m_completeSet) && (m_completeTimeStamp - sampleTimeStamp > TOLERANCE) ) {
+                m_header->lateFrames.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (nullptr == match) {
+                match = openSetFor(sampleTimeStamp);
+                if (nullptr == match) {
+                    m_header->droppedFrames.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+            }
+            slot = match->slot;
+            set = match->set;
+            match->present |= BIT;
+            m_pendingCopies[static_cast<uint32_t>(slot)]++;
+            m_header->slotHeader(static_cast<uint32_t>(slot)).sampleTimeStampInMicroseconds[camera].store(sampleTimeStamp, std::memory_order_relaxed);
+        }
+
+        std::memcpy(m_header->frameData(static_cast<uint32_t>(slot), camera), frame, m_header->cameras[camera].frameSize);
+
+        bool published{false};
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_pendingCopies[static_cast<uint32_t>(slot)]--;
+            for (auto &openSet : m_openSets) {
+                if ( (slot == openSet.slot) && (set == openSet.set) ) {
+                    openSet.copied |= BIT;
+                    if (m_allCameras == openSet.copied) {
+                        m_header->slotHeader(static_cast<uint32_t>(slot)).sequence.store(2 * set, std::memory_order_release);
+                        m_header->latestSlot.store(slot, std::memory_order_release);
+                        m_header->setId.store(set, std::memory_order_release);
+                        m_header->completeSets.fetch_add(1, std::memory_order_relaxed);
+                        m_completeSet = set;
+                        m_completeTimeStamp = openSet.timeStamp;
+                        openSet.slot = -1;
+                        published = true;
+                    }
+                    break;
+                }
+            }
+            if (published) {
+                // Sets opened before the published one would make setId go back.
+                for (auto &openSet : m_openSets) {
+                    if ( (0 <= openSet.slot) && (openSet.set < set) ) {
+                        abandon(openSet);
+                    }
+                }
+            }
+        }
+        if (published && m_onPublish) {
+            m_onPublish();
+        }
+    }
+
+   private:
+    /**
+     * Abandons the open sets that a missing camera has already passed by more
+     * than the tolerance, i.e., that cannot be completed anymore.
+     *
+     * @param tolerance Tolerance in microseconds.
+     */
+    void evictStaleSets(int64_t tolerance) noexcept {
+        for (auto &openSet : m_openSets) {
+            if (0 > openSet.slot) {
+                continue;
+            }
+            for (uint32_t camera{0}; camera < m_header->cameraCount; camera++) {
+                if ( (0 == (openSet.present & (1u << camera))) &&
+                     (std::numeric_limits<int64_t>::min() != m_lastTimeStamps[camera]) &&
+                     (m_lastTimeStamps[camera] - openSet.timeStamp > tolerance) ) {
+                    abandon(openSet);
+                    break;
+                }
+            }
+        }
+    }
+
+    /**
+     * Opens a new set, abandoning the oldest open set if the window is full.
+     *
+     * @param sampleTimeStamp Time stamp of the set in microseconds.
+     * @return The new set, or nullptr if no slot is free.
+     */
+    OpenSet *openSetFor(int64_t sampleTimeStamp) noexcept {
+        OpenSet *entry{nullptr};
+        for (auto &openSet : m_openSets) {
+            if (0 > openSet.slot) {
+                entry = &openSet;
+                break;
+            }
+            if ( (nullptr == entry) || (openSet.timeStamp < entry->timeStamp) ) {
+                entry = &openSet;
+            }
+        }
+        if (0 <= entry->slot) {
+            abandon(*entry);
+        }
+        const int32_t SLOT{freeSlot()};
+        if (0 > SLOT) {
+            return nullptr;
+        }
+        entry->slot = SLOT;
+        entry->set = ++m_lastSet;
+        entry->timeStamp = sampleTimeStamp;
+        entry->present = 0;
+        entry->copied = 0;
+        m_header->slotHeader(static_cast<uint32_t>(SLOT)).sequence.store(2 * entry->set - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return entry;
+    }
+
+    /**
+     * Closes an open set as incomplete; its set ID is skipped.
+     */
+    void abandon(OpenSet &openSet) noexcept {
+        m_header->incompleteSets.fetch_add(1, std::memory_order_relaxed);
+        openSet.slot = -1;
+    }
+
+    /**
+     * @return A slot that is neither the latest complete set, nor an open set, nor being copied into, or -1.
+     */
+    int32_t freeSlot() noexcept {
+        const int32_t LATEST{m_header->latestSlot.load(std::memory_order_relaxed)};
+        for (uint32_t i{1}; i <= m_header->slotCount; i++) {
+            const uint32_t candidate{(m_lastSlot + i) % m_header->slotCount};
+            bool open{false};
+            for (auto &openSet : m_openSets) {
+                open = open || (static_cast<int32_t>(candidate) == openSet.slot);
+            }
+            if ( (static_cast<int32_t>(candidate) != LATEST) && !open && (0 == m_pendingCopies[candidate]) ) {
+                m_lastSlot = candidate;
+                return static_cast<int32_t>(candidate);
+            }
+        }
+        return -1;
+    }
+
+   private:
+    FrameSetHeader *m_header{nullptr};
+    std::function<void()> m_onPublish{};
+
+    std::mutex m_mutex{};
+    std::vector<uint32_t> m_pendingCopies{};
+    std::vector<int64_t> m_lastTimeStamps{};
+    uint32_t m_allCameras{0};
+    uint32_t m_lastSlot{0};
+    uint64_t m_lastSet{0};
+    std::array<OpenSet, MAX_OPEN_SETS> m_openSets{};
+    uint64_t m_completeSet{0};
+    int64_t m_completeTimeStamp{0};
+};
+
+#endif
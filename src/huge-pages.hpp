@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUGE_PAGES_HPP
+#define HUGE_PAGES_HPP
+
+#include <sys/mman.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+/**
+ * Backing of shared memory areas with 2 MB pages.
+ *
+ * The areas are created by cluon::SharedMemory (SysV or POSIX shared memory),
+ * which consumers attach to by name; both live on the kernel's shmem
+ * filesystem. Instead of moving them to hugetlbfs, which every consumer would
+ * have to know about, the mappings are marked for transparent huge pages:
+ * shmem then allocates 2 MB pages for the area, which are shared with every
+ * consumer that maps the same range. The kernel only does so if
+ * /sys/kernel/mm/transparent_hugepage/shmem_enabled is "advise", "within_size",
+ * or "always" and falls back to 4 KB pages otherwise.
+ */
+namespace hugepages {
+
+constexpr std::size_t PAGE_SIZE{2 * 1024 * 1024};
+
+/**
+ * @return Selected policy for transparent huge pages on shmem ("never",
+ *         "advise", "within_size", "always", ...) or "" if unsupported.
+ */
+inline std::string shmemPolicy() noexcept {
+    std::ifstream file{"/sys/kernel/mm/transparent_hugepage/shmem_enabled"};
+    std::string policy;
+    while (file >> policy) {
+        // The selected policy is the one in brackets.
+        if ( (2 < policy.size()) && ('[' == policy.front()) && (']' == policy.back()) ) {
+            return policy.substr(1, policy.size() - 2);
+        }
+    }
+    return "";
+}
+
+/**
+ * @return true if the policy allows huge pages for areas marked by advise().
+ */
+inline bool available(const std::string &policy) noexcept {
+    return ("advise" == policy) || ("within_size" == policy) || ("always" == policy) || ("force" == policy);
+}
+
+/**
+ * Asks the kernel to back the 2 MB aligned part of the given mapping with
+ * huge pages; must be called before the pages are touched for the first time.
+ *
+ * @return false if the range holds no complete huge page or madvise failed.
+ */
+inline bool advise(char *data, std::size_t size) noexcept {
+    const uintptr_t BEGIN{(reinterpret_cast<uintptr_t>(data) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)};
+    const uintptr_t END{(reinterpret_cast<uintptr_t>(data) + size) & ~(PAGE_SIZE - 1)};
+    if (END <= BEGIN) {
+        return false;
+    }
+    return 0 == madvise(reinterpret_cast<void*>(BEGIN), END - BEGIN, MADV_HUGEPAGE);
+}
+
+/**
+ * @return Bytes of the mapping containing data that are currently mapped
+ *         with huge pages in this process (from /proc/self/smaps).
+ */
+inline std::size_t mappedBytes(const char *data) noexcept {
+    const uintptr_t ADDRESS{reinterpret_cast<uintptr_t>(data)};
+    std::ifstream smaps{"/proc/self/smaps"};
+    std::string line;
+    bool inMapping{false};
+    while (std::getline(smaps, line)) {
+        unsigned long begin{0}, end{0};
+        // Lines starting a mapping look like "7f0c1c000000-7f0c1e200000 rw-s ...".
+        if (2 == std::sscanf(line.c_str(), "%lx-%lx ", &begin, &end)) {
+            inMapping = (begin <= ADDRESS) && (ADDRESS < end);
+        }
+        else if (inMapping && (0 == line.find("ShmemPmdMapped:"))) {
+            std::stringstream sstr{line.substr(15)};
+            std::size_t kB{0};
+            sstr >> kB;
+            return kB * 1024;
+        }
+    }
+    return 0;
+}
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef I420_PYRAMID_HPP
+#define I420_PYRAMID_HPP
+
+#include <libyuv.h>
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Image pyramid of I420 frames at half, quarter, and eighth resolution.
+ *
+ * Every level is computed from the level above it with a 2x2 box filter,
+ * i.e., the full-resolution frame is only read once for the half-resolution
+ * level. To keep every level a valid I420 frame and the stripes of adjacent
+ * levels aligned, width and height of the full frame must be multiples of
+ * 2^(levels+1).
+ */
+namespace pyramid {
+
+constexpr uint32_t MAX_LEVELS{3};
+
+inline const char *levelName(uint32_t level) noexcept {
+    switch (level) {
+        case 1: return "half";
+        case 2: return "quarter";
+        case 3: return "eighth";
+    }
+    return "";
+}
+
+/**
+ * @return true if a frame of width x height can be scaled down for levels.
+ */
+inline bool isValid(uint32_t width, uint32_t height, uint32_t levels) noexcept {
+    const uint32_t MULTIPLE{2u << levels};
+    return (levels <= MAX_LEVELS) && (0 == width % MULTIPLE) && (0 == height % MULTIPLE);
+}
+
+/**
+ * Scales the rows [beginRow, endRow) of the destination level from the
+ * I420 frame of the level above; beginRow and endRow must be even.
+ *
+ * @param src I420 frame of the level above (2*width x 2*height).
+ * @param dst I420 frame of this level (width x height).
+ * @param width Width of this level.
+ * @param height Height of this level.
+ * @param beginRow First row of this level to compute.
+ * @param endRow Row after the last row of this level to compute.
+ */
+inline void scaleDown(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t height, uint32_t beginRow, uint32_t endRow) noexcept {
+    const uint32_t SRC_WIDTH{width * 2};
+    const uint32_t SRC_HEIGHT{height * 2};
+    const uint8_t *srcY{src};
+    const uint8_t *srcU{src + SRC_WIDTH * SRC_HEIGHT};
+    const uint8_t *srcV{srcU + (SRC_WIDTH / 2) * (SRC_HEIGHT / 2)};
+    uint8_t *dstY{dst};
+    uint8_t *dstU{dst + width * height};
+    uint8_t *dstV{dstU + (width / 2) * (height / 2)};
+    const int W{static_cast<int>(width)};
+    const int ROWS{static_cast<int>(endRow - beginRow)};
+    libyuv::I420Scale(srcY + 2 * beginRow * SRC_WIDTH, 2 * W,
+                      srcU + beginRow * (SRC_WIDTH / 2), W,
+                      srcV + beginRow * (SRC_WIDTH / 2), W,
+                      2 * W, 2 * ROWS,
+                      dstY + beginRow * width, W,
+                      dstU + (beginRow / 2) * (width / 2), W / 2,
+                      dstV + (beginRow / 2) * (width / 2), W / 2,
+                      W, ROWS, libyuv::kFilterBox);
+}
+
+/**
+ * Scales only the Y plane as scaleDown() does, e.g., for monochrome frames
+ * whose chroma planes are constant.
+ */
+inline void scaleDownLuma(const uint8_t *src, uint8_t *dst, uint32_t width, uint32_t beginRow, uint32_t endRow) noexcept {
+    const int W{static_cast<int>(width)};
+    const int ROWS{static_cast<int>(endRow - beginRow)};
+    libyuv::ScalePlane(src + 2 * beginRow * (2 * width), 2 * W, 2 * W, 2 * ROWS,
+                       dst + beginRow * width, W, W, ROWS, libyuv::kFilterBox);
+}
+
+}
+
+#endif
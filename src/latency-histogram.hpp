@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Lock-free histogram of latencies in microseconds with logarithmic buckets
+ * as in HdrHistogram.
+ *
+ * Values below 32 us have their own bucket; above, every power of two is
+ * split into 16 buckets, i.e., a value is reported with a relative error of
+ * at most 1/16. Values up to 2^32 us are covered; larger values are
+ * counted in the last bucket. record() is a single relaxed atomic increment
+ * and can be called from any thread; readers take a snapshot of the counts
+ * and compute percentiles from it, e.g., from the difference of two
+ * snapshots for an interval.
+ */
+class LatencyHistogram {
+   private:
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram(LatencyHistogram &&)      = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+    LatencyHistogram &operator=(LatencyHistogram &&) = delete;
+
+   public:
+    static constexpr uint32_t SUB_BUCKETS{32};
+    static constexpr uint32_t HALF_SUB_BUCKETS{SUB_BUCKETS / 2};
+    static constexpr uint32_t BUCKETS{SUB_BUCKETS + 27 * HALF_SUB_BUCKETS};
+
+   public:
+    LatencyHistogram() noexcept {
+        for (auto &c : m_counts) {
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @param valueInMicroseconds Latency to count; negative values count as 0.
+     */
+    void record(int64_t valueInMicroseconds) noexcept {
+        m_counts[indexOf(valueInMicroseconds)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @param counts Receives the current count of every bucket.
+     */
+    void snapshot(std::vector<uint64_t> &counts) const noexcept {
+        counts.resize(BUCKETS);
+        for (uint32_t i{0}; i < BUCKETS; i++) {
+            counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    static uint32_t indexOf(int64_t valueInMicroseconds) noexcept {
+        const uint64_t V{(0 > valueInMicroseconds) ? 0 : ((0xFFFFFFFFll < valueInMicroseconds) ? 0xFFFFFFFFull : static_cast<uint64_t>(valueInMicroseconds))};
+        if (SUB_BUCKETS > V) {
+            return static_cast<uint32_t>(V);
+        }
+        const uint32_t EXPONENT{static_cast<uint32_t>(63 - __builtin_clzll(V))};
+        const uint32_t SHIFT{EXPONENT - 4};
+        return SUB_BUCKETS + (SHIFT - 1) * HALF_SUB_BUCKETS + static_cast<uint32_t>(V >> SHIFT) - HALF_SUB_BUCKETS;
+    }
+
+    /**
+     * @return Largest value in microseconds that is counted in the bucket.
+     */
+    static uint64_t valueOf(uint32_t index) noexcept {
+        if (SUB_BUCKETS > index) {
+            return index;
+        }
+        const uint32_t SHIFT{(index - SUB_BUCKETS) / HALF_SUB_BUCKETS + 1};
+        const uint64_t MANTISSA{(index - SUB_BUCKETS) % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS};
+        return ((MANTISSA + 1) << SHIFT) - 1;
+    }
+
+    /**
+     * @param counts Counts of the buckets.
+     * @param p Percentile between 0 and 1.
+     * @return Value in microseconds that p of the counted values do not exceed.
+     */
+    static uint64_t percentile(const std::vector<uint64_t> &counts, double p) noexcept {
+        const uint64_t RANK{static_cast<uint64_t>(p * static_cast<double>(total(counts)) + 0.5)};
+        uint64_t sum{0};
+        for (uint32_t i{0}; i < counts.size(); i++) {
+            sum += counts[i];
+            if ( (0 < counts[i]) && (sum >= RANK) ) {
+                return valueOf(i);
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @return Value of the highest non-empty bucket.
+     */
+    static uint64_t maximum(const std::vector<uint64_t> &counts) noexcept {
+        for (uint32_t i{static_cast<uint32_t>(counts.size())}; 0 < i; i--) {
+            if (0 < counts[i - 1]) {
+                return valueOf(i - 1);
+            }
+        }
+        return 0;
+    }
+
+    static uint64_t total(const std::vector<uint64_t> &counts) noexcept {
+        uint64_t sum{0};
+        for (auto c : counts) {
+            sum += c;
+        }
+        return sum;
+    }
+
+   private:
+    std::atomic<uint64_t> m_counts[BUCKETS];
+};
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NUMA_HPP
+#define NUMA_HPP
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Placement of memory and threads on the NUMA node of a network interface,
+ * based on sysfs and the mbind syscall so that libnuma is not needed.
+ *
+ * All functions report failure instead of throwing; on machines with a
+ * single node, the node of an interface is usually unknown (-1).
+ */
+namespace numa {
+
+/**
+ * @return NUMA node of the PCI device behind the network interface or -1.
+ */
+inline int32_t nodeOfInterface(const std::string &name) noexcept {
+    std::ifstream file{"/sys/class/net/" + name + "/device/numa_node"};
+    int32_t node{-1};
+    if (!(file >> node)) {
+        return -1;
+    }
+    return node;
+}
+
+/**
+ * @param address IPv4 address of a local network interface like "192.168.0.1".
+ * @return Name of the network interface with this address or "".
+ */
+inline std::string interfaceOfAddress(const std::string &address) noexcept {
+    std::string name;
+    struct ifaddrs *interfaces{nullptr};
+    if (0 == getifaddrs(&interfaces)) {
+        for (struct ifaddrs *it{interfaces}; (nullptr != it) && name.empty(); it = it->ifa_next) {
+            if ( (nullptr != it->ifa_addr) && (AF_INET == it->ifa_addr->sa_family) ) {
+                char buffer[INET_ADDRSTRLEN]{};
+                const struct sockaddr_in *ipv4{reinterpret_cast<const struct sockaddr_in*>(it->ifa_addr)};
+                if ( (nullptr != inet_ntop(AF_INET, &ipv4->sin_addr, buffer, sizeof(buffer))) && (address == buffer) ) {
+                    name = it->ifa_name;
+                }
+            }
+        }
+        freeifaddrs(interfaces);
+    }
+    return name;
+}
+
+/**
+ * @return CPUs of the NUMA node (empty if the node is unknown).
+ */
+inline cpu_set_t cpusOfNode(int32_t node) noexcept {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    // The list looks like "0-7,16-23".
+    std::ifstream file{"/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"};
+    std::string range;
+    while (std::getline(file, range, ',')) {
+        std::stringstream sstr{range};
+        int32_t first{-1}, last{-1};
+        char dash{0};
+        if (sstr >> first) {
+            last = (sstr >> dash >> last) ? last : first;
+            for (int32_t cpu{first}; (0 <= cpu) && (cpu <= last) && (cpu < CPU_SETSIZE); cpu++) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+    }
+    return cpus;
+}
+
+/**
+ * Binds the memory to the NUMA node: pages are allocated on the node from now
+ * on and pages that are already present are moved there. For shared memory,
+ * the policy applies to all processes mapping it.
+ *
+ * @return false if the policy could not be set.
+ */
+inline bool bindMemory(char *data, std::size_t size, int32_t node) noexcept {
+    constexpr int MPOL_BIND{2};
+    constexpr unsigned MPOL_MF_MOVE{1u << 1};
+    constexpr std::size_t NODES{1024};
+    if ( (0 > node) || (NODES <= static_cast<std::size_t>(node)) ) {
+        return false;
+    }
+    unsigned long mask[NODES / (8 * sizeof(unsigned long))]{};
+    mask[static_cast<std::size_t>(node) / (8 * sizeof(unsigned long))] = 1ul << (static_cast<std::size_t>(node) % (8 * sizeof(unsigned long)));
+
+    const uintptr_t PAGE_SIZE{static_cast<uintptr_t>(sysconf(_SC_PAGESIZE))};
+    const uintptr_t BEGIN{reinterpret_cast<uintptr_t>(data) & ~(PAGE_SIZE - 1)};
+    const uintptr_t END{reinterpret_cast<uintptr_t>(data) + size};
+    return 0 == syscall(SYS_mbind, BEGIN, END - BEGIN, MPOL_BIND, mask, NODES + 1, MPOL_MF_MOVE);
+}
+
+/**
+ * @return Bytes per NUMA node of the mapping containing data (from /proc/self/numa_maps).
+ */
+inline std::vector<uint64_t> bytesPerNode(const char *data) noexcept {
+    const unsigned long ADDRESS{static_cast<unsigned long>(reinterpret_cast<uintptr_t>(data))};
+    std::vector<uint64_t> bytes;
+    unsigned long closest{0};
+    std::ifstream file{"/proc/self/numa_maps"};
+    std::string line;
+    // Every line starts with the first address of a mapping; the mapping
+    // containing data is the one starting closest below it.
+    while (std::getline(file, line)) {
+        std::stringstream sstr{line};
+        unsigned long start{0};
+        if (!(sstr >> std::hex >> start >> std::dec) || (ADDRESS < start) || (start < closest)) {
+            continue;
+        }
+        closest = start;
+        std::vector<uint64_t> pages;
+        uint64_t pageSize{4096};
+        std::string entry;
+        while (sstr >> entry) {
+            if ( (2 < entry.size()) && ('N' == entry[0]) && (std::string::npos != entry.find('=')) ) {
+                const std::size_t NODE{static_cast<std::size_t>(std::stoul(entry.substr(1, entry.find('=') - 1)))};
+                pages.resize(std::max(pages.size(), NODE + 1), 0);
+                pages[NODE] = std::stoull(entry.substr(entry.find('=') + 1));
+            }
+            else if (0 == entry.find("kernelpagesize_kB=")) {
+                pageSize = std::stoull(entry.substr(18)) * 1024;
+            }
+        }
+        for (auto &p : pages) {
+            p *= pageSize;
+        }
+        bytes = pages;
+    }
+    return bytes;
+}
+
+}
+
+#endif
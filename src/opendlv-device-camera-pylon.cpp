@@ -17,6 +17,25 @@
 
 #include "cluon-complete.hpp"
 #include "opendlv-standard-message-set.hpp"
+#include "bayer-converter.hpp"
+#include "camera-clock-model.hpp"
+#include "flight-recorder.hpp"
+#include "frame-queue.hpp"
+#include "frame-recorder.hpp"
+#include "frame-set-assembler.hpp"
+#include "huge-pages.hpp"
+#include "i420-pyramid.hpp"
+#include "latency-histogram.hpp"
+#include "numa.hpp"
+#include "output-formats.hpp"
+#include "packed-pixels.hpp"
+#include "pixel-formats.hpp"
+#include "realtime.hpp"
+#include "shared-memory-buffer-factory.hpp"
+#include "shared-memory-layout.hpp"
+#include "stripe-thread-pool.hpp"
+#include "x11-preview.hpp"
+#include "yuyv-converter.hpp"
 
 #include <pylon/PylonIncludes.h>
 #include <pylon/BaslerUniversalInstantCamera.h>
@@ -25,307 +44,1814 @@
 #include <libyuv.h>
 #include <X11/Xlib.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
 #include <cstdlib>
 #include <cstdint>
+#include <cstring>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace Pylon;
 using namespace GenApi;
 
-int32_t main(int32_t argc, char **argv) {
-    // Automatic initialization and cleanup.
-    Pylon::PylonAutoInitTerm autoInitTerm;
+/**
+ * Counters of one camera; they are aggregated over all cameras of this process.
+ */
+struct CameraStatistics {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> failedGrabs{0};
+    std::atomic<uint64_t> drops{0};
+    std::atomic<uint64_t> lostFrames{0};
+    std::atomic<uint64_t> skippedImages{0};
+    std::atomic<uint64_t> incompleteFrames{0};
+    std::atomic<uint64_t> conversions{0};
+    std::atomic<uint64_t> conversionTimeInMicroseconds{0};
+};
+
+/**
+ * @param lastBlockId Block ID of the previous grab result.
+ * @param blockId Block ID of the current grab result.
+ * @return Number of frames between both that never reached the host.
+ */
+static uint64_t framesMissingBetween(uint64_t lastBlockId, uint64_t blockId) noexcept {
+    if (blockId > lastBlockId) {
+        return blockId - lastBlockId - 1;
+    }
+    // The 16 bit block IDs of GigE Vision 1.x wrap from 65535 to 1; anything
+    // else going backwards is a restart of the stream.
+    if ( (0xFFFF >= lastBlockId) && (0 < blockId) && (blockId < lastBlockId) ) {
+        return (0xFFFF - lastBlockId) + (blockId - 1);
+    }
+    return 0;
+}
+
+// Number of requests to dump the latency histograms (SIGUSR1).
+static std::atomic<uint32_t> latencyDumpRequests{0};
+
+static void requestLatencyDump(int) {
+    latencyDumpRequests.fetch_add(1);
+}
+
+// Number of requests to dump the flight recorders (SIGUSR2 or cluon.data.RecorderCommand).
+static std::atomic<uint32_t> flightRecorderDumpRequests{0};
 
+static void requestFlightRecorderDump(int) {
+    flightRecorderDumpRequests.fetch_add(1);
+}
+
+/**
+ * A grabbed frame with its time stamps as handed over from the grab loop to
+ * the conversion; the time stamps are taken as soon as the frame arrived.
+ */
+struct GrabbedFrame {
+    CBaslerUniversalGrabResultPtr grabResult{};
+    cluon::data::TimeStamp receivedOnHost{};
+    // Time stamp from the camera's clock (PTP time when synchronized).
+    int64_t cameraTimeStampInMicroseconds{0};
+    // Time stamp to publish the frame with.
+    int64_t sampleTimeStampInMicroseconds{0};
+};
+
+/**
+ * Stops and joins a thread when leaving the scope, also when an exception
+ * unwinds it; destroying a joinable std::thread would terminate the process.
+ */
+class ThreadJoiner {
+   private:
+    ThreadJoiner(const ThreadJoiner &) = delete;
+    ThreadJoiner(ThreadJoiner &&)      = delete;
+    ThreadJoiner &operator=(const ThreadJoiner &) = delete;
+    ThreadJoiner &operator=(ThreadJoiner &&) = delete;
+
+   public:
+    /**
+     * @param thread Thread to join.
+     * @param stop Called before joining to make the thread return.
+     */
+    ThreadJoiner(std::thread &thread, std::function<void()> stop) noexcept
+        : m_thread{thread}
+        , m_stop{std::move(stop)} {
+    }
+
+    ~ThreadJoiner() {
+        if (m_thread.joinable()) {
+            m_stop();
+            m_thread.join();
+        }
+    }
+
+   private:
+    std::thread &m_thread;
+    std::function<void()> m_stop;
+};
+
+/**
+ * Selects the command line arguments for the camera with the given index.
+ *
+ * The values of per-camera arguments are lists with one entry per camera;
+ * width, height, ROI, packet size, frame rate, and pixel format may also be given once for
+ * all cameras. Lists of outputs and pyramid names contain commas themselves
+ * and are separated by ';' per camera.
+ *
+ * @return false if a per-camera argument does not match the number of cameras.
+ */
+static bool selectCameraArguments(const std::map<std::string, std::string> &commandlineArguments, uint32_t camera, uint32_t cameras, std::map<std::string, std::string> &selectedArguments) {
+    selectedArguments = commandlineArguments;
+    if (1 == cameras) {
+        return true;
+    }
+    auto split = [](const std::string &value, char delimiter) {
+        std::vector<std::string> entries;
+        std::stringstream sstr{value};
+        std::string entry;
+        while (std::getline(sstr, entry, delimiter)) {
+            entries.push_back(entry);
+        }
+        return entries;
+    };
+    for (const auto &key : {"camera", "id", "name.i420", "name.argb", "name.yuyv", "name.raw16", "output", "name.pyramid", "width", "height", "offsetX", "offsetY", "packetsize", "fps", "pixelformat", "cpu.grab", "cpu.receive", "cpu.conversion", "cpu.monitor", "numa", "rec"}) {
+        if (0 == commandlineArguments.count(key)) {
+            continue;
+        }
+        const std::string KEY{key};
+        const bool IS_LIST{("output" == KEY) || ("name.pyramid" == KEY) || ("cpu.conversion" == KEY)};
+        const bool IS_UNIQUE{IS_LIST || ("camera" == KEY) || ("id" == KEY) || (0 == KEY.find("name.")) || (0 == KEY.find("cpu.")) || ("rec" == KEY)};
+        const std::vector<std::string> values{split(commandlineArguments.at(key), IS_LIST ? ';' : ',')};
+        if (values.size() == cameras) {
+            selectedArguments[key] = values[camera];
+        }
+        else if (IS_UNIQUE || (1 != values.size())) {
+            std::cerr << "[opendlv-device-camera-pylon]: --" << key << " needs " << (IS_UNIQUE ? "" : "one or ") << cameras << " values for " << cameras << " cameras." << std::endl;
+            return false;
+        }
+    }
+    // Default names and sender stamps per camera.
+    if (0 == commandlineArguments.count("id")) {
+        selectedArguments["id"] = std::to_string(camera);
+    }
+    if (0 == commandlineArguments.count("name.i420")) {
+        selectedArguments["name.i420"] = "video" + std::to_string(camera) + ".i420";
+    }
+    if (0 == commandlineArguments.count("name.argb")) {
+        selectedArguments["name.argb"] = "video" + std::to_string(camera) + ".argb";
+    }
+    return true;
+}
+
+/**
+ * Grabs the frames of one camera and publishes them until od4 stops running.
+ *
+ * @param commandlineArguments Arguments selected for this camera.
+ * @param lstDevices Devices enumerated once for all cameras.
+ * @param od4 OD4Session shared by all cameras.
+ * @param statistics Counters of this camera.
+ * @param cameraIndex Index of this camera.
+ * @param frameSetAssembler Assembler to hand over the I420 frames to or nullptr.
+ * @return 0 on success.
+ */
+static int32_t runCamera(std::map<std::string, std::string> commandlineArguments, const DeviceInfoList_t &lstDevices, cluon::OD4Session &od4, CameraStatistics &statistics, uint32_t cameraIndex, FrameSetAssembler *frameSetAssembler) {
     int32_t retCode{0};
-    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
-    if ( (0 == commandlineArguments.count("cid")) ||
-         (0 == commandlineArguments.count("camera")) ||
-         (0 == commandlineArguments.count("width")) ||
-         (0 == commandlineArguments.count("height")) ) {
-        std::cerr << argv[0] << " interfaces with a Pylon camera (given by the numerical identifier, e.g., 0) and provides the captured image in two shared memory areas: one in I420 format and one in ARGB format." << std::endl;
-        std::cerr << "Usage:   " << argv[0] << " --camera=<identifier> --width=<width> --height=<height> [--name.i420=<unique name for the shared memory in I420 format>] [--name.argb=<unique name for the shared memory in ARGB format>] --width=W --height=H [--offsetX=X] [--offsetY=Y] [--packetsize=1500] [--fps=17] [--verbose]" << std::endl;
-        std::cerr << "         --cid:    CID of the OD4Session to send and receive messages" << std::endl;
-        std::cerr << "         --id:     ID to use as senderStamp for sending" << std::endl;
-        std::cerr << "         --camera:     serial number for Pylon-compatible camera to be used" << std::endl;
-        std::cerr << "         --name.i420:  name of the shared memory for the I420 formatted image; when omitted, 'video0.i420' is chosen" << std::endl;
-        std::cerr << "         --name.argb:  name of the shared memory for the I420 formatted image; when omitted, 'video0.argb' is chosen" << std::endl;
-        std::cerr << "         --skip.argb:  don't decode frame into argb format; default: false" << std::endl;
-        std::cerr << "         --width:      desired width of a frame" << std::endl;
-        std::cerr << "         --height:     desired height of a frame" << std::endl;
-        std::cerr << "         --offsetX:    X for desired ROI (default: 0)" << std::endl;
-        std::cerr << "         --offsetY:    Y for desired ROI (default: 0)" << std::endl;
-        std::cerr << "         --packetsize: if supported by the adapter (eg., jumbo frames), use this packetsize (default: 1500)" << std::endl;
-        std::cerr << "         --autoexposuretimeabslowerlimit: default: 26" << std::endl;
-        std::cerr << "         --autoexposuretimeabsupperlimit: default: 50000" << std::endl;
-        std::cerr << "         --fps:        desired acquisition frame rate (depends on bandwidth)" << std::endl;
-        std::cerr << "         --sync:       force all cameras to capture in sync (lowers frame rate)" << std::endl;
-        std::cerr << "         --verbose:    display captured image" << std::endl;
-        std::cerr << "         --info:       show grabbing information " << std::endl;
-        std::cerr << "Example: " << argv[0] << " --camera=0 --width=640 --height=480 --verbose" << std::endl;
-        retCode = 1;
+    const uint32_t ID{(commandlineArguments["id"].size() != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["id"])) : 0};
+    const std::string CAMERA{commandlineArguments["camera"]};
+    const uint32_t WIDTH{static_cast<uint32_t>(std::stoi(commandlineArguments["width"]))};
+    const uint32_t HEIGHT{static_cast<uint32_t>(std::stoi(commandlineArguments["height"]))};
+    const uint32_t OFFSET_X{static_cast<uint32_t>((commandlineArguments.count("offsetX") != 0) ?std::stoi(commandlineArguments["offsetX"]) : 0)};
+    const uint32_t OFFSET_Y{static_cast<uint32_t>((commandlineArguments.count("offsetY") != 0) ?std::stoi(commandlineArguments["offsetY"]) : 0)};
+    const uint32_t PACKET_SIZE{static_cast<uint32_t>((commandlineArguments.count("packetsize") != 0) ?std::stoi(commandlineArguments["packetsize"]) : 1500)};
+    const uint32_t AUTOEXPOSURETIMEABSLOWERLIMIT{static_cast<uint32_t>((commandlineArguments.count("autoexposuretimeabslowerlimit") != 0) ? std::stoi(commandlineArguments["autoexposuretimeabslowerlimit"]) : 26)};
+    const uint32_t AUTOEXPOSURETIMEABSUPPERLIMIT{static_cast<uint32_t>((commandlineArguments.count("autoexposuretimeabsupperlimit") != 0) ? std::stoi(commandlineArguments["autoexposuretimeabsupperlimit"]) : 50000)};
+    const float FPS{static_cast<float>((commandlineArguments.count("fps") != 0) ? std::stof(commandlineArguments["fps"]) : 17)};
+    const bool VERBOSE{commandlineArguments.count("verbose") != 0};
+    const float PREVIEW_FPS{static_cast<float>((commandlineArguments.count("verbose.fps") != 0) ? std::stof(commandlineArguments["verbose.fps"]) : 10)};
+    const std::string REC{commandlineArguments["rec"]};
+    const float FLIGHT_RECORDER{static_cast<float>((commandlineArguments.count("flightrecorder") != 0) ? std::stof(commandlineArguments["flightrecorder"]) : 0)};
+    const std::string FLIGHT_RECORDER_DIR{(commandlineArguments.count("flightrecorder.dir") != 0) ? commandlineArguments["flightrecorder.dir"] : "."};
+    const bool FLIGHT_RECORDER_ON_ERROR{commandlineArguments.count("flightrecorder.onerror") != 0};
+    const uint32_t REC_QUEUE{static_cast<uint32_t>((commandlineArguments.count("rec.queue") != 0) ? std::stoi(commandlineArguments["rec.queue"]) : 16)};
+    const uint32_t PREVIEW_SCALE{static_cast<uint32_t>((commandlineArguments.count("verbose.scale") != 0) ? std::stoi(commandlineArguments["verbose.scale"]) : 1)};
+    const bool SYNC{commandlineArguments.count("sync") != 0};
+    const bool INFO{commandlineArguments.count("info") != 0};
+    const bool SKIP_ARGB{commandlineArguments.count("skip.argb") != 0};
+    const bool PIPELINE{commandlineArguments.count("pipeline") != 0};
+    const uint32_t QUEUE_SIZE{static_cast<uint32_t>((commandlineArguments.count("queue.size") != 0) ? std::stoi(commandlineArguments["queue.size"]) : 4)};
+    const FrameQueue<GrabbedFrame>::OverflowPolicy QUEUE_POLICY{("block" == commandlineArguments["queue.policy"]) ? FrameQueue<GrabbedFrame>::OverflowPolicy::BLOCK : FrameQueue<GrabbedFrame>::OverflowPolicy::DROP_OLDEST};
+    std::atomic<bool> conversionWorkerDone{false};
+    const bool FUSED{commandlineArguments.count("fused") != 0};
+    // Unless the camera's time stamps are requested, frames are published in host time.
+    const bool CLOCK_MODEL{"camera" != commandlineArguments["timestamp"]};
+    const uint32_t LATENCY_EXPORT{static_cast<uint32_t>((commandlineArguments.count("latency.export") != 0) ? std::max(0, std::stoi(commandlineArguments["latency.export"])) : 0)};
+    const uint32_t CLOCK_WINDOW{static_cast<uint32_t>((commandlineArguments.count("clock.window") != 0) ? std::max(0, std::stoi(commandlineArguments["clock.window"])) : 128)};
+    const uint32_t THREADS{static_cast<uint32_t>((commandlineArguments.count("threads") != 0) ? std::max(1, std::stoi(commandlineArguments["threads"])) : 1)};
+    // Real-time priorities: the receive thread above the grab thread above the conversion threads.
+    const bool REALTIME{commandlineArguments.count("realtime") != 0};
+    // Fault in and lock all frame memory and run a dummy conversion before the first frame.
+    const bool WARMUP{REALTIME || (commandlineArguments.count("warmup") != 0)};
+    const int32_t REALTIME_PRIORITY{(commandlineArguments.count("realtime.priority") != 0) ? std::min(98, std::max(2, std::stoi(commandlineArguments["realtime.priority"]))) : 50};
+    const int32_t CPU_GRAB{(commandlineArguments.count("cpu.grab") != 0) ? std::stoi(commandlineArguments["cpu.grab"]) : -1};
+    const int32_t CPU_RECEIVE{(commandlineArguments.count("cpu.receive") != 0) ? std::stoi(commandlineArguments["cpu.receive"]) : -1};
+    const int32_t CPU_MONITOR{(commandlineArguments.count("cpu.monitor") != 0) ? std::stoi(commandlineArguments["cpu.monitor"]) : -1};
+    const std::vector<int32_t> CPUS_CONVERSION{realtime::parseCPUs(commandlineArguments["cpu.conversion"])};
+    // NUMA node to keep the frame memory and the threads on: the node of the camera's network interface (auto) or a given one.
+    const bool NUMA{commandlineArguments.count("numa") != 0};
+    const bool NUMA_AUTO{NUMA && (commandlineArguments["numa"].empty() || ("auto" == commandlineArguments["numa"]))};
+    const int32_t NUMA_NODE{(NUMA && !NUMA_AUTO) ? std::stoi(commandlineArguments["numa"]) : -1};
+    // YUYV unless --pixelformat selects another format.
+    pixel::Format PIXEL_FORMAT{pixel::FORMATS[0]};
+    if ( (commandlineArguments.count("pixelformat") != 0) && !pixel::parse(commandlineArguments["pixelformat"], PIXEL_FORMAT) ) {
+        std::cerr << "[opendlv-device-camera-pylon]: Unknown pixel format '" << commandlineArguments["pixelformat"] << "'." << std::endl;
+        return retCode = 1;
     }
-    else {
-        const uint32_t ID{(commandlineArguments["id"].size() != 0) ? static_cast<uint32_t>(std::stoi(commandlineArguments["id"])) : 0};
-        const std::string CAMERA{commandlineArguments["camera"]};
-        const uint32_t WIDTH{static_cast<uint32_t>(std::stoi(commandlineArguments["width"]))};
-        const uint32_t HEIGHT{static_cast<uint32_t>(std::stoi(commandlineArguments["height"]))};
-        const uint32_t OFFSET_X{static_cast<uint32_t>((commandlineArguments.count("offsetX") != 0) ?std::stoi(commandlineArguments["offsetX"]) : 0)};
-        const uint32_t OFFSET_Y{static_cast<uint32_t>((commandlineArguments.count("offsetY") != 0) ?std::stoi(commandlineArguments["offsetY"]) : 0)};
-        const uint32_t PACKET_SIZE{static_cast<uint32_t>((commandlineArguments.count("packetsize") != 0) ?std::stoi(commandlineArguments["packetsize"]) : 1500)};
-        const uint32_t AUTOEXPOSURETIMEABSLOWERLIMIT{static_cast<uint32_t>((commandlineArguments.count("autoexposuretimeabslowerlimit") != 0) ? std::stoi(commandlineArguments["autoexposuretimeabslowerlimit"]) : 26)};
-        const uint32_t AUTOEXPOSURETIMEABSUPPERLIMIT{static_cast<uint32_t>((commandlineArguments.count("autoexposuretimeabsupperlimit") != 0) ? std::stoi(commandlineArguments["autoexposuretimeabsupperlimit"]) : 50000)};
-        const float FPS{static_cast<float>((commandlineArguments.count("fps") != 0) ? std::stof(commandlineArguments["fps"]) : 17)};
-        const bool VERBOSE{commandlineArguments.count("verbose") != 0};
-        const bool SYNC{commandlineArguments.count("sync") != 0};
-        const bool INFO{commandlineArguments.count("info") != 0};
-        const bool SKIP_ARGB{commandlineArguments.count("skip.argb") != 0};
+    if ( (0 != WIDTH % 2) || (0 != HEIGHT % 2) ) {
+        // I420 subsamples the chroma by two in both directions.
+        std::cerr << "[opendlv-device-camera-pylon]: Width and height must be even." << std::endl;
+        return retCode = 1;
+    }
+    if (0 != WIDTH % pixel::widthAlignment(PIXEL_FORMAT)) {
+        // Packed rows are unpacked from byte boundaries.
+        std::cerr << "[opendlv-device-camera-pylon]: The width must be a multiple of " << pixel::widthAlignment(PIXEL_FORMAT) << " for pixel format '" << PIXEL_FORMAT.name << "'." << std::endl;
+        return retCode = 1;
+    }
+    const bool BAYER{pixel::Kind::BAYER == PIXEL_FORMAT.kind};
+    const bool MONO{pixel::Kind::MONO == PIXEL_FORMAT.kind};
+    const uint32_t SRC_STRIDE{pixel::stride(PIXEL_FORMAT, WIDTH)};
+    // Packed frames are unpacked into 16 bit and tone mapped into 8 bit for I420 and ARGB.
+    const bool PACKED{pixel::isPacked(PIXEL_FORMAT)};
+    const double TONE_MAP_GAMMA{(commandlineArguments.count("tonemap.gamma") != 0) ? std::max(0.1, std::stod(commandlineArguments["tonemap.gamma"])) : 2.2};
+    // In pipeline mode, queued frames hold on to their buffers and hence,
+    // Pylon needs enough spare buffers to continue receiving.
+    const uint32_t MAX_NUM_BUFFER{PIPELINE ? std::max<uint32_t>(10, QUEUE_SIZE + 4) : 10};
 
-        cluon::OD4Session od4{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"]))};
+    // Set up the names for the shared memory areas.
+    std::string NAME_I420{"video0.i420"};
+    if ((commandlineArguments["name.i420"].size() != 0)) {
+        NAME_I420 = commandlineArguments["name.i420"];
+    }
+    std::string NAME_ARGB{"video0.argb"};
+    if ((commandlineArguments["name.argb"].size() != 0)) {
+        NAME_ARGB = commandlineArguments["name.argb"];
+    }
+    const std::string NAME_YUYV{commandlineArguments["name.yuyv"]};
+    const std::string NAME_RAW16{(commandlineArguments["name.raw16"].size() != 0) ? commandlineArguments["name.raw16"] : NAME_I420 + ".raw16"};
+    // The seqlock publishing is the ring layout with a single slot.
+    const bool SEQLOCK{(commandlineArguments.count("publish") != 0) && ("seqlock" == commandlineArguments["publish"])};
+    const uint32_t SLOTS{static_cast<uint32_t>((commandlineArguments.count("slots") != 0) ? std::max(0, std::stoi(commandlineArguments["slots"])) : (SEQLOCK ? 1 : 0))};
+
+    // Unless in compatibility mode, the time stamps are stored in a header
+    // at the beginning of each area instead of using a syscall per frame.
+    const bool COMPAT_TIMESTAMP{commandlineArguments.count("compat.timestamp") != 0};
+    // Readers register in the header of an area to request conversions on demand.
+    const bool ON_DEMAND{commandlineArguments.count("on-demand") != 0};
+    const int64_t ON_DEMAND_TIMEOUT{static_cast<int64_t>((commandlineArguments.count("on-demand.timeout") != 0) ? std::stoi(commandlineArguments["on-demand.timeout"]) : 1000) * 1000};
+    if (COMPAT_TIMESTAMP && (0 < SLOTS)) {
+        // The file time stamp can only be set while holding the lock, which the ring layout never takes.
+        std::cerr << "[opendlv-device-camera-pylon]: --compat.timestamp cannot be combined with --slots or --publish=seqlock." << std::endl;
+        return retCode = 1;
+    }
+    if (ON_DEMAND && COMPAT_TIMESTAMP) {
+        std::cerr << "[opendlv-device-camera-pylon]: --on-demand requires a header in the shared memory areas and cannot be combined with --compat.timestamp." << std::endl;
+        return retCode = 1;
+    }
+    auto sizeOfArea = [SLOTS, COMPAT_TIMESTAMP](uint32_t frameSize) {
+        if (0 < SLOTS) {
+            return FrameRingHeader::sizeOfArea(SLOTS, frameSize);
+        }
+        return COMPAT_TIMESTAMP ? frameSize : FrameAreaHeader::sizeOfArea(frameSize);
+    };
+    // Back the shared memory areas with 2 MB pages if the kernel allows it.
+    const bool HUGE_PAGES{commandlineArguments.count("hugepages") != 0};
+    if (HUGE_PAGES && !hugepages::available(hugepages::shmemPolicy())) {
+        std::clog << "[opendlv-device-camera-pylon]: Transparent huge pages for shared memory are disabled (shmem_enabled: '" << hugepages::shmemPolicy() << "'); using 4 KB pages." << std::endl;
+    }
+    auto useHugePages = [HUGE_PAGES](cluon::SharedMemory &sharedMemory) {
+        if (HUGE_PAGES && (hugepages::PAGE_SIZE <= sharedMemory.size()) && !hugepages::advise(sharedMemory.data(), sharedMemory.size())) {
+            std::clog << "[opendlv-device-camera-pylon]: Failed to request huge pages for shared memory '" << sharedMemory.name() << "'; using 4 KB pages." << std::endl;
+        }
+    };
+
+    const uint32_t SIZE_I420{WIDTH * HEIGHT * 3/2};
+    std::unique_ptr<cluon::SharedMemory> sharedMemoryI420(new cluon::SharedMemory{NAME_I420, sizeOfArea(SIZE_I420)});
+    if (!sharedMemoryI420 || !sharedMemoryI420->valid()) {
+        std::cerr << "[opendlv-device-camera-pylon]: Failed to create shared memory '" << NAME_I420 << "'." << std::endl;
+        return retCode = 1;
+    }
+    useHugePages(*sharedMemoryI420);
 
-        // Set up the names for the shared memory areas.
-        std::string NAME_I420{"video0.i420"};
-        if ((commandlineArguments["name.i420"].size() != 0)) {
-            NAME_I420 = commandlineArguments["name.i420"];
+    const uint32_t SIZE_ARGB{WIDTH * HEIGHT * 4};
+    std::unique_ptr<cluon::SharedMemory> sharedMemoryARGB(new cluon::SharedMemory{NAME_ARGB, sizeOfArea(SIZE_ARGB)});
+    if (!sharedMemoryARGB || !sharedMemoryARGB->valid()) {
+        std::cerr << "[opendlv-device-camera-pylon]: Failed to create shared memory '" << NAME_ARGB << "'." << std::endl;
+        return retCode = 1;
+    }
+    useHugePages(*sharedMemoryARGB);
+
+    // With the ring layout, the last SLOTS frames are kept in each area.
+    FrameRingHeader *ringI420{nullptr};
+    FrameRingHeader *ringARGB{nullptr};
+    FrameAreaHeader *headerI420{nullptr};
+    FrameAreaHeader *headerARGB{nullptr};
+    if (0 < SLOTS) {
+        sharedMemoryI420->lock();
+        {
+            ringI420 = FrameRingHeader::create(sharedMemoryI420->data(), WIDTH, HEIGHT, SLOTS, SIZE_I420);
         }
-        std::string NAME_ARGB{"video0.argb"};
-        if ((commandlineArguments["name.argb"].size() != 0)) {
-            NAME_ARGB = commandlineArguments["name.argb"];
+        sharedMemoryI420->unlock();
+        sharedMemoryARGB->lock();
+        {
+            ringARGB = FrameRingHeader::create(sharedMemoryARGB->data(), WIDTH, HEIGHT, SLOTS, SIZE_ARGB);
         }
+        sharedMemoryARGB->unlock();
+    }
+    else if (!COMPAT_TIMESTAMP) {
+        sharedMemoryI420->lock();
+        {
+            headerI420 = FrameAreaHeader::create(sharedMemoryI420->data(), WIDTH, HEIGHT, SIZE_I420);
+        }
+        sharedMemoryI420->unlock();
+        sharedMemoryARGB->lock();
+        {
+            headerARGB = FrameAreaHeader::create(sharedMemoryARGB->data(), WIDTH, HEIGHT, SIZE_ARGB);
+        }
+        sharedMemoryARGB->unlock();
+    }
+    ReaderRegistry *registryI420{(nullptr != ringI420) ? &ringI420->registry : ((nullptr != headerI420) ? &headerI420->registry : nullptr)};
+    ReaderRegistry *registryARGB{(nullptr != ringARGB) ? &ringARGB->registry : ((nullptr != headerARGB) ? &headerARGB->registry : nullptr)};
 
-        std::unique_ptr<cluon::SharedMemory> sharedMemoryI420(new cluon::SharedMemory{NAME_I420, WIDTH * HEIGHT * 3/2});
-        if (!sharedMemoryI420 || !sharedMemoryI420->valid()) {
-            std::cerr << "[opendlv-device-camera-pylon]: Failed to create shared memory '" << NAME_I420 << "'." << std::endl;
+    // Additional outputs, sorted such that every format follows the ones it may be derived from.
+    std::vector<output::Output> outputs;
+    if ( (commandlineArguments.count("output") != 0) && !output::parse(commandlineArguments["output"], outputs) ) {
+        std::cerr << "[opendlv-device-camera-pylon]: Invalid list of outputs '" << commandlineArguments["output"] << "'." << std::endl;
+        return retCode = 1;
+    }
+    std::stable_sort(outputs.begin(), outputs.end(), [](const output::Output &a, const output::Output &b) { return a.format < b.format; });
+    struct OutputArea {
+        output::Format format{output::Format::GRAY};
+        std::unique_ptr<cluon::SharedMemory> sharedMemory{nullptr};
+        FrameRingHeader *ring{nullptr};
+        FrameAreaHeader *header{nullptr};
+        ReaderRegistry *registry{nullptr};
+        bool wanted{true};
+    };
+    std::vector<OutputArea> outputAreas;
+    bool hasOutputRGBP{false};
+    for (const auto &o : outputs) {
+        const uint32_t SIZE{output::frameSize(o.format, WIDTH, HEIGHT)};
+        OutputArea area;
+        area.format = o.format;
+        area.sharedMemory.reset(new cluon::SharedMemory{o.name, sizeOfArea(SIZE)});
+        if (!area.sharedMemory->valid()) {
+            std::cerr << "[opendlv-device-camera-pylon]: Failed to create shared memory '" << o.name << "'." << std::endl;
             return retCode = 1;
         }
+        useHugePages(*area.sharedMemory);
+        area.sharedMemory->lock();
+        {
+            if (0 < SLOTS) {
+                area.ring = FrameRingHeader::create(area.sharedMemory->data(), WIDTH, HEIGHT, SLOTS, SIZE);
+                area.registry = &area.ring->registry;
+            }
+            else if (!COMPAT_TIMESTAMP) {
+                area.header = FrameAreaHeader::create(area.sharedMemory->data(), WIDTH, HEIGHT, SIZE);
+                area.registry = &area.header->registry;
+            }
+        }
+        area.sharedMemory->unlock();
+        hasOutputRGBP = hasOutputRGBP || (output::Format::RGBP == o.format);
+        std::clog << "[opendlv-device-camera-pylon]: Data from camera '" << commandlineArguments["camera"]<< "' available in " << output::formatName(o.format) << " format in shared memory '" << area.sharedMemory->name() << "' (" << area.sharedMemory->size() << ")." << std::endl;
+        outputAreas.push_back(std::move(area));
+    }
+    // Planar RGB is split from RGB24, which is converted here when not an output itself.
+    std::vector<uint8_t> scratchRGB24(hasOutputRGBP ? WIDTH * HEIGHT * 3 : 0);
+
+    // Levels of the I420 image pyramid, each one scaled down from the level above.
+    const uint32_t PYRAMID_LEVELS{static_cast<uint32_t>((commandlineArguments.count("pyramid") != 0) ? std::max(0, std::stoi(commandlineArguments["pyramid"])) : 0)};
+    if (!pyramid::isValid(WIDTH, HEIGHT, PYRAMID_LEVELS)) {
+        std::cerr << "[opendlv-device-camera-pylon]: --pyramid supports up to " << pyramid::MAX_LEVELS << " levels and requires width and height to be multiples of " << (2u << std::min(PYRAMID_LEVELS, pyramid::MAX_LEVELS)) << "." << std::endl;
+        return retCode = 1;
+    }
+    struct PyramidArea {
+        uint32_t width{0};
+        uint32_t height{0};
+        std::unique_ptr<cluon::SharedMemory> sharedMemory{nullptr};
+        FrameRingHeader *ring{nullptr};
+        FrameAreaHeader *header{nullptr};
+        ReaderRegistry *registry{nullptr};
+        bool wanted{true};
+    };
+    std::vector<PyramidArea> pyramidAreas;
+    {
+        std::vector<std::string> names;
+        std::stringstream sstr{commandlineArguments["name.pyramid"]};
+        std::string name;
+        while (std::getline(sstr, name, ',')) {
+            names.push_back(name);
+        }
+        for (uint32_t level{1}; level <= PYRAMID_LEVELS; level++) {
+            PyramidArea area;
+            area.width = WIDTH >> level;
+            area.height = HEIGHT >> level;
+            const uint32_t SIZE{area.width * area.height * 3/2};
+            const std::string NAME{((level <= names.size()) && !names[level - 1].empty()) ? names[level - 1] : NAME_I420 + "." + pyramid::levelName(level)};
+            area.sharedMemory.reset(new cluon::SharedMemory{NAME, sizeOfArea(SIZE)});
+            if (!area.sharedMemory->valid()) {
+                std::cerr << "[opendlv-device-camera-pylon]: Failed to create shared memory '" << NAME << "'." << std::endl;
+                return retCode = 1;
+            }
+            useHugePages(*area.sharedMemory);
+            area.sharedMemory->lock();
+            {
+                if (0 < SLOTS) {
+                    area.ring = FrameRingHeader::create(area.sharedMemory->data(), area.width, area.height, SLOTS, SIZE);
+                    area.registry = &area.ring->registry;
+                }
+                else if (!COMPAT_TIMESTAMP) {
+                    area.header = FrameAreaHeader::create(area.sharedMemory->data(), area.width, area.height, SIZE);
+                    area.registry = &area.header->registry;
+                }
+            }
+            area.sharedMemory->unlock();
+            std::clog << "[opendlv-device-camera-pylon]: Data from camera '" << commandlineArguments["camera"]<< "' available at " << pyramid::levelName(level) << " resolution (" << area.width << "x" << area.height << ") in I420 format in shared memory '" << area.sharedMemory->name() << "' (" << area.sharedMemory->size() << ")." << std::endl;
+            pyramidAreas.push_back(std::move(area));
+        }
+    }
 
-        std::unique_ptr<cluon::SharedMemory> sharedMemoryARGB(new cluon::SharedMemory{NAME_ARGB, WIDTH * HEIGHT * 4});
-        if (!sharedMemoryARGB || !sharedMemoryARGB->valid()) {
-            std::cerr << "[opendlv-device-camera-pylon]: Failed to create shared memory '" << NAME_ARGB << "'." << std::endl;
+    // Packed frames are published unpacked with 16 bits per sample.
+    std::unique_ptr<cluon::SharedMemory> sharedMemoryRaw16{nullptr};
+    FrameRingHeader *ringRaw16{nullptr};
+    FrameAreaHeader *headerRaw16{nullptr};
+    ReaderRegistry *registryRaw16{nullptr};
+    if (PACKED) {
+        const uint32_t SIZE{WIDTH * HEIGHT * 2};
+        sharedMemoryRaw16.reset(new cluon::SharedMemory{NAME_RAW16, sizeOfArea(SIZE)});
+        if (!sharedMemoryRaw16->valid()) {
+            std::cerr << "[opendlv-device-camera-pylon]: Failed to create shared memory '" << NAME_RAW16 << "'." << std::endl;
             return retCode = 1;
         }
+        useHugePages(*sharedMemoryRaw16);
+        sharedMemoryRaw16->lock();
+        {
+            if (0 < SLOTS) {
+                ringRaw16 = FrameRingHeader::create(sharedMemoryRaw16->data(), WIDTH, HEIGHT, SLOTS, SIZE);
+                registryRaw16 = &ringRaw16->registry;
+            }
+            else if (!COMPAT_TIMESTAMP) {
+                headerRaw16 = FrameAreaHeader::create(sharedMemoryRaw16->data(), WIDTH, HEIGHT, SIZE);
+                registryRaw16 = &headerRaw16->registry;
+            }
+        }
+        sharedMemoryRaw16->unlock();
+        std::clog << "[opendlv-device-camera-pylon]: Data from camera '" << commandlineArguments["camera"]<< "' available with " << PIXEL_FORMAT.bitDepth << " bits in 16 bit samples in shared memory '" << sharedMemoryRaw16->name() << "' (" << sharedMemoryRaw16->size() << ")." << std::endl;
+    }
 
-        if ( (sharedMemoryI420 && sharedMemoryI420->valid()) &&
-             (sharedMemoryARGB && sharedMemoryARGB->valid()) ) {
-            std::clog << "[opendlv-device-camera-pylon]: Data from camera '" << commandlineArguments["camera"]<< "' available in I420 format in shared memory '" << sharedMemoryI420->name() << "' (" << sharedMemoryI420->size() << ") and in ARGB format in shared memory '" << sharedMemoryARGB->name() << "' (" << sharedMemoryARGB->size() << ")." << std::endl;
-
-            // Accessing the low-level X11 data display.
-            Display* display{nullptr};
-            Visual* visual{nullptr};
-            Window window{0};
-            XImage* ximage{nullptr};
-            if (VERBOSE) {
-                display = XOpenDisplay(NULL);
-                visual = DefaultVisual(display, 0);
-                window = XCreateSimpleWindow(display, RootWindow(display, 0), 0, 0, WIDTH, HEIGHT, 1, 0, 0);
-                sharedMemoryARGB->lock();
-                {
-                    ximage = XCreateImage(display, visual, 24, ZPixmap, 0, sharedMemoryARGB->data(), WIDTH, HEIGHT, 32, 0);
+    // The chroma planes of monochrome frames are constant and hence, filled only once.
+    if (MONO) {
+        auto fillChroma = [](cluon::SharedMemory &sharedMemory, FrameRingHeader *ring, FrameAreaHeader *header, uint32_t width, uint32_t height) {
+            sharedMemory.lock();
+            {
+                const uint32_t COUNT{(nullptr != ring) ? ring->slotCount : 1};
+                for (uint32_t i{0}; i < COUNT; i++) {
+                    char *frame{(nullptr != ring) ? ring->slotData(i) : ((nullptr != header) ? header->frameData() : sharedMemory.data())};
+                    std::memset(frame + width * height, 128, width * height / 2);
                 }
-                sharedMemoryARGB->unlock();
-                XMapWindow(display, window);
             }
+            sharedMemory.unlock();
+        };
+        fillChroma(*sharedMemoryI420, ringI420, headerI420, WIDTH, HEIGHT);
+        for (auto &area : pyramidAreas) {
+            fillChroma(*area.sharedMemory, area.ring, area.header, area.width, area.height);
+        }
+    }
 
-            try {
-                IPylonDevice *pDevice{nullptr};
-                {
-                  // Find specified camera.
-                  CTlFactory& TlFactory = CTlFactory::GetInstance();
-                  DeviceInfoList_t lstDevices;
-                  TlFactory.EnumerateDevices(lstDevices);
-                  if (!lstDevices.empty()) {
-                    uint8_t cameraCounter{0};
-                    for(DeviceInfoList_t::const_iterator it = lstDevices.begin(); it != lstDevices.end(); it++, cameraCounter++) {
-                      std::clog << "[opendlv-device-camera-pylon]: " << it->GetModelName() << " (" << it->GetSerialNumber() << ") at " << it->GetIpAddress() << std::endl;
-                      std::stringstream sstr;
-                      sstr << it->GetSerialNumber();
-                      const std::string str{sstr.str()};
-                      if (str.find(CAMERA) != std::string::npos) {
-                        pDevice = TlFactory.CreateDevice(lstDevices[cameraCounter]);
-                      }
-                    }
+    // The frame loss counters are published in the header of every area.
+    std::vector<FrameLossCounters*> lossCounters;
+    {
+        auto addLossCounters = [&lossCounters](FrameRingHeader *ring, FrameAreaHeader *header) {
+            if (nullptr != ring) {
+                lossCounters.push_back(&ring->loss);
+            }
+            else if (nullptr != header) {
+                lossCounters.push_back(&header->loss);
+            }
+        };
+        addLossCounters(ringI420, headerI420);
+        addLossCounters(ringARGB, headerARGB);
+        addLossCounters(ringRaw16, headerRaw16);
+        for (auto &area : outputAreas) {
+            addLossCounters(area.ring, area.header);
+        }
+        for (auto &area : pyramidAreas) {
+            addLossCounters(area.ring, area.header);
+        }
+    }
+
+    if ( (sharedMemoryI420 && sharedMemoryI420->valid()) &&
+         (sharedMemoryARGB && sharedMemoryARGB->valid()) ) {
+        std::clog << "[opendlv-device-camera-pylon]: Data from camera '" << commandlineArguments["camera"]<< "' available in I420 format in shared memory '" << sharedMemoryI420->name() << "' (" << sharedMemoryI420->size() << ") and in ARGB format in shared memory '" << sharedMemoryARGB->name() << "' (" << sharedMemoryARGB->size() << ")." << std::endl;
+
+        // The preview runs in its own thread so that grabbing never waits for the X server.
+        std::unique_ptr<X11Preview> preview{nullptr};
+        if (VERBOSE) {
+            preview.reset(new X11Preview{commandlineArguments["camera"], WIDTH, HEIGHT, PREVIEW_SCALE, PREVIEW_FPS});
+        }
+
+        // The I420 frames are written to the .rec file by a separate thread so that grabbing never waits for the disk.
+        std::unique_ptr<FrameRecorder> recorder{nullptr};
+        if (!REC.empty()) {
+            recorder.reset(new FrameRecorder{REC, "I420", WIDTH, HEIGHT, WIDTH * HEIGHT * 3/2, ID, REC_QUEUE});
+            if (!recorder->valid()) {
+                std::cerr << "[opendlv-device-camera-pylon]: Failed to create '" << REC << "' for recording or frames of " << WIDTH << "x" << HEIGHT << " exceed 16 MB." << std::endl;
+                return retCode = 1;
+            }
+            std::clog << "[opendlv-device-camera-pylon]: Recording frames of camera '" << CAMERA << "' as opendlv.proxy.ImageReading in I420 format to '" << REC << "' (" << recorder->capacity() << " frames buffered, " << (recorder->direct() ? "direct I/O" : "page cache") << ")." << std::endl;
+        }
+
+        // The raw frames of the last seconds are kept in memory and written to a .rec file on request.
+        std::unique_ptr<FlightRecorder> flightRecorder{nullptr};
+        if (0 < FLIGHT_RECORDER) {
+            const uint32_t FRAMES{static_cast<uint32_t>(std::ceil(FLIGHT_RECORDER * FPS))};
+            flightRecorder.reset(new FlightRecorder{FLIGHT_RECORDER_DIR + "/flightrecorder-" + CAMERA, PIXEL_FORMAT.fourcc, WIDTH, HEIGHT, SRC_STRIDE * HEIGHT, PACKED ? PIXEL_FORMAT.bitDepth : 0, ID, FRAMES, flightRecorderDumpRequests});
+            if (!flightRecorder->valid()) {
+                std::cerr << "[opendlv-device-camera-pylon]: Failed to allocate " << ((static_cast<uint64_t>(SRC_STRIDE) * HEIGHT * FRAMES) >> 20) << " MB for the flight recorder or frames of " << WIDTH << "x" << HEIGHT << " exceed 16 MB." << std::endl;
+                return retCode = 1;
+            }
+            std::clog << "[opendlv-device-camera-pylon]: Flight recorder of camera '" << CAMERA << "' keeps the last " << FRAMES << " raw frames in " << (flightRecorder->size() >> 20) << " MB" << (flightRecorder->locked() ? " locked into RAM" : "") << "; SIGUSR2 or cluon.data.RecorderCommand dumps them to '" << FLIGHT_RECORDER_DIR << "'." << std::endl;
+        }
+
+        try {
+            // The shared memory for the raw frames and the buffer factory
+            // placing them there must outlive the camera.
+            std::unique_ptr<cluon::SharedMemory> sharedMemoryYUYV{nullptr};
+            std::unique_ptr<SharedMemoryBufferFactory> bufferFactory{nullptr};
+            RawFrameAreaHeader *rawFrameAreaHeader{nullptr};
+            // Grab buffers locked into RAM for the warm-up.
+            std::unique_ptr<realtime::LockedMemory> grabBuffers{nullptr};
+
+            IPylonDevice *pDevice{nullptr};
+            {
+              // Find specified camera among the devices enumerated once for all cameras.
+              CTlFactory& TlFactory = CTlFactory::GetInstance();
+              if (!lstDevices.empty()) {
+                uint8_t cameraCounter{0};
+                for(DeviceInfoList_t::const_iterator it = lstDevices.begin(); it != lstDevices.end(); it++, cameraCounter++) {
+                  std::stringstream sstr;
+                  sstr << it->GetSerialNumber();
+                  const std::string str{sstr.str()};
+                  if (str.find(CAMERA) != std::string::npos) {
+                    pDevice = TlFactory.CreateDevice(lstDevices[cameraCounter]);
                   }
                 }
+              }
+            }
 
-                if (pDevice == nullptr) {
-                    std::cout << "[opendlv-device-camera-pylon] Failed to open camera." << std::endl;
-                    return -1;
+            if (pDevice == nullptr) {
+                std::cout << "[opendlv-device-camera-pylon] Failed to open camera." << std::endl;
+                return -1;
+            }
+
+            CBaslerUniversalInstantCamera camera(pDevice);
+            std::clog << "[opendlv-device-camera-pylon]: Using " << camera.GetDeviceInfo().GetModelName() << " (" << camera.GetDeviceInfo().GetSerialNumber() << ") at " << camera.GetDeviceInfo().GetIpAddress() << std::endl;
+
+            // All threads of this camera are created by this thread and
+            // inherit its cores, which are limited to the NUMA node here.
+            int32_t numaNode{NUMA_NODE};
+            cpu_set_t cpusOfNumaNode;
+            CPU_ZERO(&cpusOfNumaNode);
+            if (NUMA) {
+                if (NUMA_AUTO) {
+                    const std::string INTERFACE{numa::interfaceOfAddress(std::string{camera.GetDeviceInfo().GetInterface().c_str()})};
+                    numaNode = numa::nodeOfInterface(INTERFACE);
+                    std::clog << "[opendlv-device-camera-pylon]: Camera '" << CAMERA << "' is connected to '" << INTERFACE << "' on NUMA node " << numaNode << "." << std::endl;
+                }
+                cpusOfNumaNode = numa::cpusOfNode(numaNode);
+                if (0 == CPU_COUNT(&cpusOfNumaNode)) {
+                    std::cerr << "[opendlv-device-camera-pylon]: NUMA node of camera '" << CAMERA << "' is unknown; the threads and frame memory are not bound." << std::endl;
+                    numaNode = -1;
                 }
+                else if (!realtime::setAffinity(pthread_self(), cpusOfNumaNode)) {
+                    std::cerr << "[opendlv-device-camera-pylon]: Failed to bind the threads of camera '" << CAMERA << "' to NUMA node " << numaNode << "." << std::endl;
+                }
+            }
 
-                CBaslerUniversalInstantCamera camera(pDevice);
-                std::clog << "[opendlv-device-camera-pylon]: Using " << camera.GetDeviceInfo().GetModelName() << " (" << camera.GetDeviceInfo().GetSerialNumber() << ") at " << camera.GetDeviceInfo().GetIpAddress() << std::endl;
+            // Open the camera for accessing the parameters.
+            camera.Open();
+            // Replace any existing configuration.
+            camera.RegisterConfiguration( new CAcquireContinuousConfiguration, RegistrationMode_ReplaceAll, Cleanup_Delete);
 
-                // Open the camera for accessing the parameters.
-                camera.Open();
-                // Replace any existing configuration.
-                camera.RegisterConfiguration( new CAcquireContinuousConfiguration, RegistrationMode_ReplaceAll, Cleanup_Delete);
+            // Enable PTP for the current camera.
+            camera.GevIEEE1588 = true;
 
-                // Enable PTP for the current camera.
-                camera.GevIEEE1588 = true;
+            {
+              // Configuring the pixel format (YUV422_YUYV_Packed by default).
+              INodeMap& nodemap = camera.GetNodeMap();
+              CEnumParameter pixelFormat(nodemap, "PixelFormat");
+              if (!pixelFormat.CanSetValue(PIXEL_FORMAT.pylonName)) {
+                std::cerr << "[opendlv-device-camera-pylon]: Camera '" << CAMERA << "' does not support pixel format " << PIXEL_FORMAT.pylonName << "." << std::endl;
+                return retCode = 1;
+              }
+              pixelFormat.SetValue(PIXEL_FORMAT.pylonName);
+              std::cout << "[opendlv-device-camera-pylon]: PixelFormat: " << pixelFormat.GetValue() << std::endl;
+            }
 
+            camera.GrayValueAdjustmentDampingAbs = 0.683594;
+            // Monochrome cameras have no white balance.
+            camera.BalanceWhiteAdjustmentDampingAbs.TrySetValue(0.976562);
+            camera.AutoFunctionProfile = Basler_UniversalCameraParams::AutoFunctionProfile_GainMinimum;
+
+            // AutoGain:
+            camera.AutoTargetValue = 50;
+            camera.AutoFunctionAOISelector = Basler_UniversalCameraParams::AutoFunctionAOISelector_AOI1;
+            camera.AutoFunctionAOIUsageIntensity = 1;
+            camera.AutoFunctionAOIUsageWhiteBalance.TrySetValue(true);
+            camera.AutoFunctionAOIWidth = WIDTH;
+            camera.AutoFunctionAOIHeight = HEIGHT;
+            camera.AutoFunctionAOIOffsetX = OFFSET_X;
+            camera.AutoFunctionAOIOffsetY = OFFSET_Y;
+            camera.GainAuto = Basler_UniversalCameraParams::GainAuto_Continuous;
+
+            // AutoExposure:
+            camera.AutoExposureTimeAbsLowerLimit = AUTOEXPOSURETIMEABSLOWERLIMIT;
+            camera.AutoExposureTimeAbsUpperLimit = AUTOEXPOSURETIMEABSUPPERLIMIT;
+            camera.ExposureAuto = Basler_UniversalCameraParams::ExposureAuto_Continuous;
+
+            // AcquisitionMode:
+            camera.AcquisitionMode = Basler_UniversalCameraParams::AcquisitionMode_Continuous;
+
+            // FPS
+            camera.AcquisitionFrameRateEnable = 1;
+            camera.AcquisitionFrameRateAbs = FPS;
+
+            if (SYNC) {
+                // Set cameras to cpature at same point in time.
+                camera.SyncFreeRunTimerTriggerRateAbs = FPS;
+                camera.SyncFreeRunTimerStartTimeHigh = 0;
+                camera.SyncFreeRunTimerStartTimeLow = 0;
+                camera.SyncFreeRunTimerEnable = true;
+            }
+            else {
+                camera.SyncFreeRunTimerEnable = false;
+                camera.SyncFreeRunTimerUpdate();
+            }
+
+            //camera.TriggerSelector = Basler_UniversalCameraParams::TriggerSelector_AcquisitionStart;
+            //camera.TriggerSelector = Basler_UniversalCameraParams::TriggerSelector_FrameBurstStart;
+            camera.TriggerSelector = Basler_UniversalCameraParams::TriggerSelector_FrameStart;
+            camera.TriggerMode = Basler_UniversalCameraParams::TriggerMode_Off;
+
+            camera.Width = WIDTH;
+            camera.Height = HEIGHT;
+            camera.OffsetX = OFFSET_X;
+            camera.OffsetY = OFFSET_Y;
+
+            // Packet size (should match MTU).
+            camera.GevSCPSPacketSize = PACKET_SIZE;
+
+            // Enable chunks in general to read meta data.
+            if (camera.ChunkModeActive.TrySetValue(true)) {
+                // Enable time stamp chunks.
+                camera.ChunkSelector.SetValue(Basler_UniversalCameraParams::ChunkSelector_Timestamp);
+                camera.ChunkEnable.SetValue(true);
+                camera.ChunkSelector.SetValue(Basler_UniversalCameraParams::ChunkSelector_ExposureTime);
+                camera.ChunkEnable.SetValue(true);
+            }
+
+            // The parameter MaxNumBuffer can be used to control the count of buffers
+            // allocated for grabbing. The default value of this parameter is 10.
+            camera.MaxNumBuffer = MAX_NUM_BUFFER;
+
+            // Every grab buffer is a page-aligned slot; the payload includes the chunk data.
+            constexpr uint32_t PAGE_SIZE{4096};
+            const uint32_t PAYLOAD_SIZE{static_cast<uint32_t>(camera.PayloadSize.GetValue())};
+            const uint32_t SLOT_SIZE{(PAYLOAD_SIZE + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE};
+            if (!NAME_YUYV.empty()) {
+                // The grab buffers are the slots of the shared memory area for the raw frames.
+                const uint32_t SLOT_OFFSET{RawFrameAreaHeader::offsetOfSlots(MAX_NUM_BUFFER)};
+
+                sharedMemoryYUYV.reset(new cluon::SharedMemory{NAME_YUYV, SLOT_OFFSET + MAX_NUM_BUFFER * SLOT_SIZE});
+                if (!sharedMemoryYUYV || !sharedMemoryYUYV->valid()) {
+                    std::cerr << "[opendlv-device-camera-pylon]: Failed to create shared memory '" << NAME_YUYV << "'." << std::endl;
+                    return retCode = 1;
+                }
+                useHugePages(*sharedMemoryYUYV);
+
+                sharedMemoryYUYV->lock();
                 {
-                  // Configuring YUV422_YUYV_Packed pixel format.
-                  INodeMap& nodemap = camera.GetNodeMap();
-                  CEnumParameter pixelFormat(nodemap, "PixelFormat");
-                  if (pixelFormat.CanSetValue("YUV422_YUYV_Packed")) {
-                    pixelFormat.SetValue("YUV422_YUYV_Packed");
-                    std::cout << "[opendlv-device-camera-pylon]: PixelFormat: " << pixelFormat.GetValue() << std::endl;
-                  }
+                    rawFrameAreaHeader = RawFrameAreaHeader::create(sharedMemoryYUYV->data(), WIDTH, HEIGHT, SRC_STRIDE, MAX_NUM_BUFFER, SLOT_SIZE);
                 }
+                sharedMemoryYUYV->unlock();
 
-                camera.GrayValueAdjustmentDampingAbs = 0.683594;
-                camera.BalanceWhiteAdjustmentDampingAbs = 0.976562;
-                camera.AutoFunctionProfile = Basler_UniversalCameraParams::AutoFunctionProfile_GainMinimum;
-
-                // AutoGain:
-                camera.AutoTargetValue = 50;
-                camera.AutoFunctionAOISelector = Basler_UniversalCameraParams::AutoFunctionAOISelector_AOI1;
-                camera.AutoFunctionAOIUsageIntensity = 1;
-                camera.AutoFunctionAOIUsageWhiteBalance = 1;
-                camera.AutoFunctionAOIWidth = WIDTH;
-                camera.AutoFunctionAOIHeight = HEIGHT;
-                camera.AutoFunctionAOIOffsetX = OFFSET_X;
-                camera.AutoFunctionAOIOffsetY = OFFSET_Y;
-                camera.GainAuto = Basler_UniversalCameraParams::GainAuto_Continuous;
-
-                // AutoExposure:
-                camera.AutoExposureTimeAbsLowerLimit = AUTOEXPOSURETIMEABSLOWERLIMIT;
-                camera.AutoExposureTimeAbsUpperLimit = AUTOEXPOSURETIMEABSUPPERLIMIT;
-                camera.ExposureAuto = Basler_UniversalCameraParams::ExposureAuto_Continuous;
-
-                // AcquisitionMode:
-                camera.AcquisitionMode = Basler_UniversalCameraParams::AcquisitionMode_Continuous;
-
-                // FPS
-                camera.AcquisitionFrameRateEnable = 1;
-                camera.AcquisitionFrameRateAbs = FPS;
-
-                if (SYNC) {
-                    // Set cameras to cpature at same point in time.
-                    camera.SyncFreeRunTimerTriggerRateAbs = FPS;
-                    camera.SyncFreeRunTimerStartTimeHigh = 0;
-                    camera.SyncFreeRunTimerStartTimeLow = 0;
-                    camera.SyncFreeRunTimerEnable = true;
+                bufferFactory.reset(new SharedMemoryBufferFactory{sharedMemoryYUYV->data() + SLOT_OFFSET, MAX_NUM_BUFFER, SLOT_SIZE});
+                camera.SetBufferFactory(bufferFactory.get(), Cleanup_None);
+                std::clog << "[opendlv-device-camera-pylon]: Raw YUYV frames available in shared memory '" << sharedMemoryYUYV->name() << "' (" << sharedMemoryYUYV->size() << ") in " << MAX_NUM_BUFFER << " slots of " << SLOT_SIZE << " bytes." << std::endl;
+            }
+            else if (WARMUP || (0 <= numaNode)) {
+                // Pylon's own grab buffers would only be faulted in by the first frames and could not be bound to a NUMA node.
+                grabBuffers.reset(new realtime::LockedMemory{static_cast<std::size_t>(MAX_NUM_BUFFER) * SLOT_SIZE});
+                if (grabBuffers->valid()) {
+                    bufferFactory.reset(new SharedMemoryBufferFactory{grabBuffers->data(), MAX_NUM_BUFFER, SLOT_SIZE});
+                    camera.SetBufferFactory(bufferFactory.get(), Cleanup_None);
                 }
                 else {
-                    camera.SyncFreeRunTimerEnable = false;
-                    camera.SyncFreeRunTimerUpdate();
+                    std::cerr << "[opendlv-device-camera-pylon]: Failed to allocate the grab buffers for camera '" << CAMERA << "'; using Pylon's buffers." << std::endl;
+                    grabBuffers.reset();
                 }
+            }
 
-                //camera.TriggerSelector = Basler_UniversalCameraParams::TriggerSelector_AcquisitionStart;
-                //camera.TriggerSelector = Basler_UniversalCameraParams::TriggerSelector_FrameBurstStart;
-                camera.TriggerSelector = Basler_UniversalCameraParams::TriggerSelector_FrameStart;
-                camera.TriggerMode = Basler_UniversalCameraParams::TriggerMode_Off;
+            // Apply the scheduling policy and the core of a thread; failures are only reported.
+            // Without a core, the thread may run on all cores of the process as
+            // new threads inherit the cores of the thread creating them.
+            const cpu_set_t CPUS_OF_PROCESS{realtime::affinity(pthread_self())};
+            auto configureThread = [&](pthread_t thread, const char *name, int32_t priority, int32_t cpu) {
+                if (REALTIME && !realtime::setPriority(thread, priority)) {
+                    std::cerr << "[opendlv-device-camera-pylon]: Failed to set SCHED_FIFO priority " << priority << " for the " << name << " thread of camera '" << CAMERA << "'." << std::endl;
+                }
+                if (0 > cpu) {
+                    realtime::setAffinity(thread, CPUS_OF_PROCESS);
+                }
+                else if (!realtime::pin(thread, cpu)) {
+                    std::cerr << "[opendlv-device-camera-pylon]: Failed to pin the " << name << " thread of camera '" << CAMERA << "' to CPU " << cpu << "." << std::endl;
+                }
+            };
 
-                camera.Width = WIDTH;
-                camera.Height = HEIGHT;
-                camera.OffsetX = OFFSET_X;
-                camera.OffsetY = OFFSET_Y;
+            // All shared memory areas of this camera.
+            auto sharedMemoryAreas = [&]() {
+                std::vector<cluon::SharedMemory*> areas;
+                for (auto area : {sharedMemoryI420.get(), sharedMemoryARGB.get(), sharedMemoryRaw16.get(), sharedMemoryYUYV.get()}) {
+                    if (nullptr != area) {
+                        areas.push_back(area);
+                    }
+                }
+                for (auto &area : outputAreas) {
+                    areas.push_back(area.sharedMemory.get());
+                }
+                for (auto &area : pyramidAreas) {
+                    areas.push_back(area.sharedMemory.get());
+                }
+                return areas;
+            };
+            auto printHugePageStatistics = [&]() {
+                if (HUGE_PAGES) {
+                    uint64_t total{0}, huge{0};
+                    for (auto area : sharedMemoryAreas()) {
+                        total += area->size();
+                        huge += hugepages::mappedBytes(area->data());
+                    }
+                    std::clog << "[opendlv-device-camera-pylon]: Huge pages of camera '" << CAMERA << "': " << (huge >> 20) << " of " << (total >> 20) << " MB of the shared memory areas." << std::endl;
+                }
+            };
 
-                // Packet size (should match MTU).
-                camera.GevSCPSPacketSize = PACKET_SIZE;
+            // Persistent threads to convert the frames in horizontal stripes.
+            StripeThreadPool stripeThreadPool{THREADS};
+            // The conversion threads are the pipeline worker (if any) followed by the stripe threads.
+            {
+                const std::vector<std::thread::native_handle_type> HANDLES{stripeThreadPool.nativeHandles()};
+                const uint32_t FIRST{PIPELINE ? 1u : 0u};
+                for (uint32_t i{0}; i < HANDLES.size(); i++) {
+                    configureThread(HANDLES[i], "conversion", REALTIME_PRIORITY - 1, (FIRST + i < CPUS_CONVERSION.size()) ? CPUS_CONVERSION[FIRST + i] : -1);
+                }
+            }
+            // Two ARGB rows per stripe to demosaic into when ARGB is not converted.
+            std::vector<uint8_t> scratchBayer(BAYER ? stripeThreadPool.stripes() * WIDTH * 8 : 0);
+            // Tone mapped packed frame and one unpacked row per stripe when the 16 bit area is not read.
+            std::vector<uint8_t> scratchPacked(PACKED ? WIDTH * HEIGHT : 0);
+            std::vector<uint16_t> scratchUnpacked(PACKED ? stripeThreadPool.stripes() * WIDTH : 0);
+            const std::vector<uint8_t> TONE_MAP{PACKED ? packed::toneMap(PIXEL_FORMAT.bitDepth, TONE_MAP_GAMMA) : std::vector<uint8_t>{}};
 
-                // Enable chunks in general to read meta data.
-                if (camera.ChunkModeActive.TrySetValue(true)) {
-                    // Enable time stamp chunks.
-                    camera.ChunkSelector.SetValue(Basler_UniversalCameraParams::ChunkSelector_Timestamp);
-                    camera.ChunkEnable.SetValue(true);
-                    camera.ChunkSelector.SetValue(Basler_UniversalCameraParams::ChunkSelector_ExposureTime);
-                    camera.ChunkEnable.SetValue(true);
+            if (0 <= numaNode) {
+                // Pages that are already present, e.g., the headers, are moved to the node.
+                bool bound{(nullptr == grabBuffers) || numa::bindMemory(grabBuffers->data(), grabBuffers->size(), numaNode)};
+                for (auto area : sharedMemoryAreas()) {
+                    bound = numa::bindMemory(area->data(), area->size(), numaNode) && bound;
+                }
+                if (!bound) {
+                    std::cerr << "[opendlv-device-camera-pylon]: Failed to bind the frame memory of camera '" << CAMERA << "' to NUMA node " << numaNode << "." << std::endl;
+                }
+            }
+            // Frames converted by a thread on another NUMA node.
+            std::atomic<uint64_t> remoteConversions{0};
+            auto printNumaStatistics = [&]() {
+                if (0 <= numaNode) {
+                    uint64_t total{0}, remote{0};
+                    auto count = [&](const char *data, uint64_t size) {
+                        total += size;
+                        const std::vector<uint64_t> BYTES{numa::bytesPerNode(data)};
+                        for (uint32_t node{0}; node < BYTES.size(); node++) {
+                            remote += (static_cast<int32_t>(node) != numaNode) ? BYTES[node] : 0;
+                        }
+                    };
+                    for (auto area : sharedMemoryAreas()) {
+                        count(area->data(), area->size());
+                    }
+                    if (nullptr != grabBuffers) {
+                        count(grabBuffers->data(), grabBuffers->size());
+                    }
+                    std::clog << "[opendlv-device-camera-pylon]: NUMA node " << numaNode << " of camera '" << CAMERA << "': " << (remote >> 20) << " of " << (total >> 20) << " MB of the frame memory on other nodes, " << remoteConversions.load(std::memory_order_relaxed) << " of " << statistics.conversions.load(std::memory_order_relaxed) << " frames converted on other nodes." << std::endl;
+                }
+            };
+
+            if (WARMUP) {
+                uint64_t warmUpBytes{0};
+                // Fault in and lock all shared memory areas and grab buffers before the first frame.
+                bool locked{(nullptr == grabBuffers) || grabBuffers->locked()};
+                for (auto area : sharedMemoryAreas()) {
+                    realtime::prefault(area->data(), area->size());
+                    locked = realtime::lock(area->data(), area->size()) && locked;
+                    warmUpBytes += area->size();
+                }
+                warmUpBytes += (nullptr != grabBuffers) ? grabBuffers->size() : 0;
+                if (!locked) {
+                    std::cerr << "[opendlv-device-camera-pylon]: Failed to lock the frame memory of camera '" << CAMERA << "' into RAM (see ulimit -l)." << std::endl;
+                }
+
+                // Convert a blank frame once to wake up the stripe threads, select
+                // the kernels, and warm up the caches; nothing is published.
+                const auto warmUpStart{std::chrono::steady_clock::now()};
+                std::vector<uint8_t> blank(SRC_STRIDE * HEIGHT);
+                std::vector<uint8_t> i420(WIDTH * HEIGHT * 3/2);
+                std::vector<uint8_t> argb(WIDTH * HEIGHT * 4);
+                const uint8_t *src{blank.data()};
+                uint32_t srcStride{SRC_STRIDE};
+                if (PACKED) {
+                    stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                        uint32_t begin{0}, end{0};
+                        StripeThreadPool::rowsOfStripe(stripe, stripes, HEIGHT, begin, end);
+                        for (uint32_t row{begin}; row < end; row++) {
+                            packed::unpackRow(src + row * SRC_STRIDE, PIXEL_FORMAT.bitDepth, scratchUnpacked.data() + stripe * WIDTH, WIDTH);
+                            packed::toneMapRow(scratchUnpacked.data() + stripe * WIDTH, TONE_MAP.data(), scratchPacked.data() + row * WIDTH, WIDTH);
+                        }
+                    });
+                    src = scratchPacked.data();
+                    srcStride = WIDTH;
                 }
+                uint8_t *dstY{i420.data()};
+                uint8_t *dstU{dstY + WIDTH * HEIGHT};
+                uint8_t *dstV{dstU + ((WIDTH * HEIGHT) >> 2)};
+                stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                    uint32_t begin{0}, end{0};
+                    StripeThreadPool::rowsOfStripe(stripe, stripes, HEIGHT, begin, end);
+                    if (MONO) {
+                        libyuv::CopyPlane(src + begin * srcStride, static_cast<int>(srcStride), dstY + begin * WIDTH, static_cast<int>(WIDTH), static_cast<int>(WIDTH), static_cast<int>(end - begin));
+                        libyuv::I400ToARGB(dstY + begin * WIDTH, WIDTH, argb.data() + begin * WIDTH * 4, WIDTH * 4, WIDTH, end - begin);
+                    }
+                    else if (BAYER) {
+                        bayer::toI420AndARGB(src, srcStride, PIXEL_FORMAT.pattern, dstY, dstU, dstV, argb.data(), scratchBayer.data() + stripe * WIDTH * 8, WIDTH, HEIGHT, begin, end);
+                    }
+                    else if (FUSED) {
+                        yuyv::toI420AndARGB(src, srcStride, dstY, dstU, dstV, argb.data(), WIDTH, begin, end);
+                    }
+                    else {
+                        libyuv::YUY2ToI420(src + begin * srcStride, srcStride,
+                                           dstY + begin * WIDTH, WIDTH,
+                                           dstU + (begin/2) * (WIDTH/2), WIDTH/2,
+                                           dstV + (begin/2) * (WIDTH/2), WIDTH/2,
+                                           WIDTH, end - begin);
+                        libyuv::I420ToARGB(dstY + begin * WIDTH, WIDTH,
+                                           dstU + (begin/2) * (WIDTH/2), WIDTH/2,
+                                           dstV + (begin/2) * (WIDTH/2), WIDTH/2,
+                                           argb.data() + begin * WIDTH * 4, WIDTH * 4, WIDTH, end - begin);
+                    }
+                });
+                std::clog << "[opendlv-device-camera-pylon]: Warm-up of camera '" << CAMERA << "': " << (warmUpBytes >> 20) << " MB of frame memory faulted in and locked, dummy conversion in " << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - warmUpStart).count() << " us." << std::endl;
+            }
 
-                // The parameter MaxNumBuffer can be used to control the count of buffers
-                // allocated for grabbing. The default value of this parameter is 10.
-                camera.MaxNumBuffer = 10;
+            if (REALTIME) {
+                // Pylon's receive thread runs with a real-time priority above the grab thread.
+                camera.GetStreamGrabberParams().ReceiveThreadPriorityOverride.TrySetValue(true);
+                camera.GetStreamGrabberParams().ReceiveThreadPriority.TrySetValue(REALTIME_PRIORITY + 1);
+            }
+            // The receive thread is started by StartGrabbing and inherits the core of this thread.
+            if (0 <= CPU_RECEIVE) {
+                realtime::pin(pthread_self(), CPU_RECEIVE);
+            }
 
-                // Start the grabbing of c_countOfImagesToGrab images.
-                // The camera device is parameterized with a default configuration which
-                // sets up free-running continuous acquisition.
-                camera.StartGrabbing();
+            // Start the grabbing of c_countOfImagesToGrab images.
+            // The camera device is parameterized with a default configuration which
+            // sets up free-running continuous acquisition.
+            camera.StartGrabbing();
+            const auto grabbingStarted{std::chrono::steady_clock::now()};
 
-                // This smart pointer will receive the grab result data.
-                //CGrabResultPtr ptrGrabResult;
-                CBaslerUniversalGrabResultPtr ptrGrabResult;
+            configureThread(pthread_self(), "grab", REALTIME_PRIORITY, CPU_GRAB);
 
-                // Frame grabbing loop.
-                const uint32_t timeoutInMS{10000};
-                while (od4.isRunning() && camera.IsGrabbing()) {
-                    // Wait for an image and then retrieve it. A timeout of 5000 ms is used.
-                    camera.RetrieveResult(timeoutInMS, ptrGrabResult, TimeoutHandling_ThrowException);
-
-                    // Image grabbed successfully?
-                    if (ptrGrabResult->GrabSucceeded()) {
-                        double exposureTime{0};
-                        cluon::data::TimeStamp nowOnHost = cluon::time::now();
-                        int64_t timeStampInMicroseconds = (static_cast<int64_t>(ptrGrabResult->GetTimeStamp())/static_cast<int64_t>(1000));
-                        if (INFO) {
-                            if (ptrGrabResult->ChunkTimestamp.IsReadable()) {
-                                timeStampInMicroseconds = (static_cast<int64_t>(ptrGrabResult->ChunkTimestamp.GetValue())/static_cast<int64_t>(1000));
-                            }
+            // Latency histograms of the stages of the capture pipeline.
+            enum LatencyStage : uint32_t {
+                RETRIEVE       = 0, // End of exposure until RetrieveResult returned (needs PTP).
+                CONVERSION     = 1, // Start of the conversion until all areas are published.
+                LOCK_WAIT      = 2, // Waiting for the lock of a shared memory area.
+                NOTIFY         = 3, // Waking up the readers of the I420 and ARGB areas.
+                SCHEDULING     = 4, // Wake-up latency on the --cpu.monitor core (--realtime).
+                LATENCY_STAGES = 5,
+            };
+            const char *LATENCY_STAGE_NAMES[LATENCY_STAGES]{"exposure end to retrieve", "conversion", "shared memory lock wait", "notify", "scheduling"};
+            LatencyHistogram latencies[LATENCY_STAGES];
+            auto describeLatency = [](const std::vector<uint64_t> &counts) {
+                std::stringstream sstr;
+                sstr << "n: " << LatencyHistogram::total(counts) << ", p50: " << LatencyHistogram::percentile(counts, 0.5) << " us, p99: " << LatencyHistogram::percentile(counts, 0.99) << " us, p99.9: " << LatencyHistogram::percentile(counts, 0.999) << " us, max: " << LatencyHistogram::maximum(counts) << " us";
+                return sstr.str();
+            };
+
+            // In real-time mode with --cpu.monitor, a thread on that core measures
+            // how late it is woken up every millisecond. It runs one above the
+            // grab thread (like Pylon's receive thread) so that it is delayed by
+            // the kernel and by the receive thread only, but not by the grab thread.
+            std::atomic<bool> schedulingMonitorDone{false};
+            std::thread schedulingMonitor;
+            ThreadJoiner schedulingMonitorJoiner{schedulingMonitor, [&]() {
+                schedulingMonitorDone.store(true);
+            }};
+            if (REALTIME && (0 <= CPU_MONITOR)) {
+                schedulingMonitor = std::thread([&]() {
+                    configureThread(pthread_self(), "scheduling monitor", REALTIME_PRIORITY + 1, CPU_MONITOR);
+                    realtime::measureSchedulingLatency(schedulingMonitorDone, latencies[SCHEDULING], 1000);
+                });
+            }
 
-                            if (ptrGrabResult->ChunkExposureTime.IsReadable()) {
-                                exposureTime = ptrGrabResult->ChunkExposureTime.GetValue();
+            // Start writing a frame to a shared memory area and return where to place it;
+            // the ring layout never waits for readers.
+            auto beginFrame = [COMPAT_TIMESTAMP, &latencies](cluon::SharedMemory &sharedMemory, FrameRingHeader *ring, FrameAreaHeader *header, uint64_t frame, const cluon::data::TimeStamp &ts, const cluon::data::TimeStamp &tsOnHost) {
+                if (nullptr != ring) {
+                    return ring->beginWrite(frame, cluon::time::toMicroseconds(ts), cluon::time::toMicroseconds(tsOnHost));
+                }
+                const auto lockRequested{std::chrono::steady_clock::now()};
+                sharedMemory.lock();
+                latencies[LOCK_WAIT].record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - lockRequested).count());
+                if (COMPAT_TIMESTAMP) {
+                    // Only stored while holding the lock.
+                    sharedMemory.setTimeStamp(ts);
+                }
+                if (nullptr != header) {
+                    header->setFrame(frame, cluon::time::toMicroseconds(ts), cluon::time::toMicroseconds(tsOnHost));
+                    return header->frameData();
+                }
+                return sharedMemory.data();
+            };
+            auto endFrame = [](cluon::SharedMemory &sharedMemory, FrameRingHeader *ring, uint64_t frame) {
+                if (nullptr != ring) {
+                    ring->endWrite(frame);
+                }
+                else {
+                    sharedMemory.unlock();
+                }
+            };
+            // Wake up any pending processes.
+            auto notifyReaders = [&latencies](cluon::SharedMemory &sharedMemory) {
+                const auto notifyStart{std::chrono::steady_clock::now()};
+                sharedMemory.notifyAll();
+                latencies[NOTIFY].record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - notifyStart).count());
+            };
+            uint64_t frameCounter{0};
+            bool convertingI420{true};
+            bool convertingARGB{!SKIP_ARGB};
+
+            // Convert a successfully grabbed frame and publish it to the shared memory areas.
+            auto processGrabResult = [&](const GrabbedFrame &grabbedFrame) {
+                const CBaslerUniversalGrabResultPtr &ptrGrabResult{grabbedFrame.grabResult};
+                double exposureTime{0};
+                const cluon::data::TimeStamp nowOnHost{grabbedFrame.receivedOnHost};
+                const int64_t timeStampInMicroseconds{grabbedFrame.sampleTimeStampInMicroseconds};
+                if (INFO) {
+                    if (ptrGrabResult->ChunkExposureTime.IsReadable()) {
+                        exposureTime = ptrGrabResult->ChunkExposureTime.GetValue();
+                    }
+                    std::cout << "[opendlv-device-camera-pylon]: Grabbed frame at " << timeStampInMicroseconds << " us (delta to host: " << cluon::time::deltaInMicroseconds(nowOnHost, cluon::time::fromMicroseconds(timeStampInMicroseconds)) << " us); sizeOfPayload: " << ptrGrabResult->GetPayloadSize() << ", exposure time: " << exposureTime << std::endl;
+                }
+                cluon::data::TimeStamp ts{cluon::time::fromMicroseconds(timeStampInMicroseconds)};
+
+                {
+                    // Propagate meta data.
+                    opendlv::proxy::AboutImageReading air;
+                    air.exposureTime(static_cast<float>(exposureTime));
+                    od4.send(air, ts, ID);
+                }
+
+                const uint8_t *imageBuffer = (uint8_t *) ptrGrabResult->GetBuffer();
+
+                const uint64_t frameNumber{++frameCounter};
+
+                // On demand, skip the conversions nobody is reading; the ARGB image and most additional outputs are derived from I420.
+                const int64_t now{cluon::time::toMicroseconds(nowOnHost)};
+                bool convertOutputFromI420{false};
+                bool convertGray{false};
+                for (auto &area : outputAreas) {
+                    area.wanted = !ON_DEMAND || area.registry->hasLiveReader(now, ON_DEMAND_TIMEOUT);
+                    convertOutputFromI420 = convertOutputFromI420 || (area.wanted && (BAYER || output::needsI420(area.format)));
+                    convertGray = convertGray || (area.wanted && (output::Format::GRAY == area.format));
+                }
+                // A pyramid level is also needed to compute any smaller level that is wanted.
+                for (auto it = pyramidAreas.rbegin(); it != pyramidAreas.rend(); it++) {
+                    it->wanted = !ON_DEMAND || it->registry->hasLiveReader(now, ON_DEMAND_TIMEOUT) || ((it != pyramidAreas.rbegin()) && std::prev(it)->wanted);
+                }
+                convertOutputFromI420 = convertOutputFromI420 || (!pyramidAreas.empty() && pyramidAreas.front().wanted);
+                bool convertARGB{!SKIP_ARGB};
+                bool convertI420{true};
+                if (ON_DEMAND) {
+                    convertARGB = convertARGB && (VERBOSE || registryARGB->hasLiveReader(now, ON_DEMAND_TIMEOUT));
+                    convertI420 = convertARGB || convertOutputFromI420 || (nullptr != frameSetAssembler) || (nullptr != recorder) || registryI420->hasLiveReader(now, ON_DEMAND_TIMEOUT);
+                    if ( (convertI420 != convertingI420) || (convertARGB != convertingARGB) ) {
+                        std::clog << "[opendlv-device-camera-pylon]: Converting into I420: " << (convertI420 ? "yes" : "no") << ", into ARGB: " << (convertARGB ? "yes" : "no") << " (frame " << frameNumber << ")." << std::endl;
+                        convertingI420 = convertI420;
+                        convertingARGB = convertARGB;
+                    }
+                }
+
+                // Unpack a packed frame and tone map it into 8 bit for the conversions below while the rows are in the cache.
+                uint32_t srcStride{SRC_STRIDE};
+                if (PACKED) {
+                    const bool TONE_MAP_WANTED{convertI420 || (MONO && convertGray)};
+                    const bool RAW16_WANTED{!ON_DEMAND || registryRaw16->hasLiveReader(now, ON_DEMAND_TIMEOUT)};
+                    if (RAW16_WANTED || TONE_MAP_WANTED) {
+                        uint16_t *raw16{RAW16_WANTED ? reinterpret_cast<uint16_t*>(beginFrame(*sharedMemoryRaw16, ringRaw16, headerRaw16, frameNumber, ts, nowOnHost)) : nullptr};
+                        stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                            uint32_t begin{0}, end{0};
+                            StripeThreadPool::rowsOfStripe(stripe, stripes, HEIGHT, begin, end);
+                            for (uint32_t row{begin}; row < end; row++) {
+                                uint16_t *dst16{(nullptr != raw16) ? raw16 + row * WIDTH : scratchUnpacked.data() + stripe * WIDTH};
+                                packed::unpackRow(imageBuffer + row * SRC_STRIDE, PIXEL_FORMAT.bitDepth, dst16, WIDTH);
+                                if (TONE_MAP_WANTED) {
+                                    packed::toneMapRow(dst16, TONE_MAP.data(), scratchPacked.data() + row * WIDTH, WIDTH);
+                                }
                             }
-                            std::cout << "[opendlv-device-camera-pylon]: Grabbed frame at " << timeStampInMicroseconds << " us (delta to host: " << cluon::time::deltaInMicroseconds(nowOnHost, cluon::time::fromMicroseconds(timeStampInMicroseconds)) << " us); sizeOfPayload: " << ptrGrabResult->GetPayloadSize() << ", exposure time: " << exposureTime << std::endl;
+                        });
+                        if (RAW16_WANTED) {
+                            endFrame(*sharedMemoryRaw16, ringRaw16, frameNumber);
+                            // Wake up any pending processes.
+                            sharedMemoryRaw16->notifyAll();
                         }
-                        cluon::data::TimeStamp ts{cluon::time::fromMicroseconds(timeStampInMicroseconds)};
+                    }
+                    imageBuffer = scratchPacked.data();
+                    srcStride = WIDTH;
+                }
+
+                // GRAY8 is taken straight from the luma of the grabbed YUYV or Mono8 frame.
+                for (auto &area : outputAreas) {
+                    if (area.wanted && !BAYER && (output::Format::GRAY == area.format)) {
+                        uint8_t *dst{reinterpret_cast<uint8_t*>(beginFrame(*area.sharedMemory, area.ring, area.header, frameNumber, ts, nowOnHost))};
+                        stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                            uint32_t begin{0}, end{0};
+                            StripeThreadPool::rowsOfStripe(stripe, stripes, HEIGHT, begin, end);
+                            if (MONO) {
+                                libyuv::CopyPlane(imageBuffer + begin * srcStride, static_cast<int>(srcStride), dst + begin * WIDTH, static_cast<int>(WIDTH), static_cast<int>(WIDTH), static_cast<int>(end - begin));
+                            }
+                            else {
+                                yuyv::toGray(imageBuffer, srcStride, dst, WIDTH, begin, end);
+                            }
+                        });
+                        endFrame(*area.sharedMemory, area.ring, frameNumber);
+                        // Wake up any pending processes.
+                        area.sharedMemory->notifyAll();
+                    }
+                }
+
+                if (!convertI420) {
+                    return;
+                }
 
+                const auto conversionStart{std::chrono::steady_clock::now()};
+                auto conversionI420Done{conversionStart};
+                char *i420{nullptr};
+                if (MONO) {
+                    // Only the Y plane changes; ARGB is expanded from it.
+                    i420 = beginFrame(*sharedMemoryI420, ringI420, headerI420, frameNumber, ts, nowOnHost);
+                    stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                        uint32_t begin{0}, end{0};
+                        StripeThreadPool::rowsOfStripe(stripe, stripes, HEIGHT, begin, end);
+                        libyuv::CopyPlane(imageBuffer + begin * srcStride, static_cast<int>(srcStride), reinterpret_cast<uint8_t*>(i420) + begin * WIDTH, static_cast<int>(WIDTH), static_cast<int>(WIDTH), static_cast<int>(end - begin));
+                    });
+                    endFrame(*sharedMemoryI420, ringI420, frameNumber);
+                    conversionI420Done = std::chrono::steady_clock::now();
+
+                    if (convertARGB) {
+                        char *argb{beginFrame(*sharedMemoryARGB, ringARGB, headerARGB, frameNumber, ts, nowOnHost)};
                         {
-                            // Propagate meta data.
-                            opendlv::proxy::AboutImageReading air;
-                            air.exposureTime(static_cast<float>(exposureTime));
-                            od4.send(air, ts, ID);
+                            const uint8_t *srcY{reinterpret_cast<uint8_t*>(i420)};
+                            uint8_t *dstARGB{reinterpret_cast<uint8_t*>(argb)};
+                            stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                                uint32_t begin{0}, end{0};
+                                StripeThreadPool::rowsOfStripe(stripe, stripes, HEIGHT, begin, end);
+                                libyuv::I400ToARGB(srcY + begin * WIDTH, WIDTH, dstARGB + begin * WIDTH * 4, WIDTH * 4, WIDTH, end - begin);
+                            });
+
+                            if (preview) {
+                                preview->offer(argb);
+                            }
                         }
+                        endFrame(*sharedMemoryARGB, ringARGB, frameNumber);
+                        notifyReaders(*sharedMemoryARGB);
+                    }
+                }
+                else if (FUSED || BAYER) {
+                    // Produce I420 and ARGB in a single pass over the grabbed frame.
+                    i420 = beginFrame(*sharedMemoryI420, ringI420, headerI420, frameNumber, ts, nowOnHost);
+                    char *argb{!convertARGB ? nullptr : beginFrame(*sharedMemoryARGB, ringARGB, headerARGB, frameNumber, ts, nowOnHost)};
+                    {
+                        uint8_t *dstY{reinterpret_cast<uint8_t*>(i420)};
+                        uint8_t *dstU{reinterpret_cast<uint8_t*>(i420+(WIDTH * HEIGHT))};
+                        uint8_t *dstV{reinterpret_cast<uint8_t*>(i420+(WIDTH * HEIGHT + ((WIDTH * HEIGHT) >> 2)))};
+                        uint8_t *dstARGB{reinterpret_cast<uint8_t*>(argb)};
+                        stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                            uint32_t begin{0}, end{0};
+                            StripeThreadPool::rowsOfStripe(stripe, stripes, HEIGHT, begin, end);
+                            if (BAYER) {
+                                bayer::toI420AndARGB(imageBuffer, srcStride, PIXEL_FORMAT.pattern, dstY, dstU, dstV, dstARGB, scratchBayer.data() + stripe * WIDTH * 8, WIDTH, HEIGHT, begin, end);
+                            }
+                            else {
+                                yuyv::toI420AndARGB(imageBuffer, srcStride, dstY, dstU, dstV, dstARGB, WIDTH, begin, end);
+                            }
+                        });
+                    }
+                    endFrame(*sharedMemoryI420, ringI420, frameNumber);
+                    conversionI420Done = std::chrono::steady_clock::now();
 
-                        const uint8_t *imageBuffer = (uint8_t *) ptrGrabResult->GetBuffer();
+                    if (convertARGB) {
+                        if (preview) {
+                            preview->offer(argb);
+                        }
+                        endFrame(*sharedMemoryARGB, ringARGB, frameNumber);
+                        notifyReaders(*sharedMemoryARGB);
+                    }
+                }
+                else {
+                    i420 = beginFrame(*sharedMemoryI420, ringI420, headerI420, frameNumber, ts, nowOnHost);
+                    {
+                        uint8_t *dstY{reinterpret_cast<uint8_t*>(i420)};
+                        uint8_t *dstU{reinterpret_cast<uint8_t*>(i420+(WIDTH * HEIGHT))};
+                        uint8_t *dstV{reinterpret_cast<uint8_t*>(i420+(WIDTH * HEIGHT + ((WIDTH * HEIGHT) >> 2)))};
+                        stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                            uint32_t begin{0}, end{0};
+                            StripeThreadPool::rowsOfStripe(stripe, stripes, HEIGHT, begin, end);
+                            libyuv::YUY2ToI420(imageBuffer + begin * WIDTH * 2, WIDTH * 2 /* 2*WIDTH for YUYV 422*/,
+                                               dstY + begin * WIDTH, WIDTH,
+                                               dstU + (begin/2) * (WIDTH/2), WIDTH/2,
+                                               dstV + (begin/2) * (WIDTH/2), WIDTH/2,
+                                               WIDTH, end - begin);
+                        });
+                    }
+                    endFrame(*sharedMemoryI420, ringI420, frameNumber);
+                    conversionI420Done = std::chrono::steady_clock::now();
 
-                        sharedMemoryI420->lock();
-                        sharedMemoryI420->setTimeStamp(ts);
+                    if (convertARGB) {
+                        char *argb{beginFrame(*sharedMemoryARGB, ringARGB, headerARGB, frameNumber, ts, nowOnHost)};
                         {
-                            libyuv::YUY2ToI420(imageBuffer, WIDTH * 2 /* 2*WIDTH for YUYV 422*/,
-                                               reinterpret_cast<uint8_t*>(sharedMemoryI420->data()), WIDTH,
-                                               reinterpret_cast<uint8_t*>(sharedMemoryI420->data()+(WIDTH * HEIGHT)), WIDTH/2,
-                                               reinterpret_cast<uint8_t*>(sharedMemoryI420->data()+(WIDTH * HEIGHT + ((WIDTH * HEIGHT) >> 2))), WIDTH/2,
-                                               WIDTH, HEIGHT);
+                            const uint8_t *srcY{reinterpret_cast<uint8_t*>(i420)};
+                            const uint8_t *srcU{reinterpret_cast<uint8_t*>(i420+(WIDTH * HEIGHT))};
+                            const uint8_t *srcV{reinterpret_cast<uint8_t*>(i420+(WIDTH * HEIGHT + ((WIDTH * HEIGHT) >> 2)))};
+                            uint8_t *dstARGB{reinterpret_cast<uint8_t*>(argb)};
+                            stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                                uint32_t begin{0}, end{0};
+                                StripeThreadPool::rowsOfStripe(stripe, stripes, HEIGHT, begin, end);
+                                libyuv::I420ToARGB(srcY + begin * WIDTH, WIDTH,
+                                                   srcU + (begin/2) * (WIDTH/2), WIDTH/2,
+                                                   srcV + (begin/2) * (WIDTH/2), WIDTH/2,
+                                                   dstARGB + begin * WIDTH * 4, WIDTH * 4, WIDTH, end - begin);
+                            });
+
+                            if (preview) {
+                                preview->offer(argb);
+                            }
                         }
-                        sharedMemoryI420->unlock();
-
-                        if (!SKIP_ARGB) {
-                            sharedMemoryARGB->lock();
-                            sharedMemoryARGB->setTimeStamp(ts);
-                            {
-                                libyuv::I420ToARGB(reinterpret_cast<uint8_t*>(sharedMemoryI420->data()), WIDTH,
-                                                   reinterpret_cast<uint8_t*>(sharedMemoryI420->data()+(WIDTH * HEIGHT)), WIDTH/2,
-                                                   reinterpret_cast<uint8_t*>(sharedMemoryI420->data()+(WIDTH * HEIGHT + ((WIDTH * HEIGHT) >> 2))), WIDTH/2,
-                                                   reinterpret_cast<uint8_t*>(sharedMemoryARGB->data()), WIDTH * 4, WIDTH, HEIGHT);
-
-                                if (VERBOSE) {
-                                    XPutImage(display, window, DefaultGC(display, 0), ximage, 0, 0, 0, 0, WIDTH, HEIGHT);
-                                }
+                        endFrame(*sharedMemoryARGB, ringARGB, frameNumber);
+                        notifyReaders(*sharedMemoryARGB);
+                    }
+                }
+
+                // Derive the additional outputs from the I420 frame.
+                {
+                    const uint8_t *srcY{reinterpret_cast<uint8_t*>(i420)};
+                    const uint8_t *srcU{reinterpret_cast<uint8_t*>(i420+(WIDTH * HEIGHT))};
+                    const uint8_t *srcV{reinterpret_cast<uint8_t*>(i420+(WIDTH * HEIGHT + ((WIDTH * HEIGHT) >> 2)))};
+                    uint8_t *rgb24{nullptr};
+                    for (auto &area : outputAreas) {
+                        if (area.wanted && (BAYER || output::needsI420(area.format))) {
+                            uint8_t *dst{reinterpret_cast<uint8_t*>(beginFrame(*area.sharedMemory, area.ring, area.header, frameNumber, ts, nowOnHost))};
+                            const bool RGB24_IS_VALID{nullptr != rgb24};
+                            uint8_t *srcRGB24{RGB24_IS_VALID ? rgb24 : scratchRGB24.data()};
+                            stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                                uint32_t begin{0}, end{0};
+                                StripeThreadPool::rowsOfStripe(stripe, stripes, HEIGHT, begin, end);
+                                output::fromI420(area.format, srcY, srcU, srcV, dst, srcRGB24, RGB24_IS_VALID, WIDTH, HEIGHT, begin, end);
+                            });
+                            if (output::Format::RGB24 == area.format) {
+                                rgb24 = dst;
                             }
-                            sharedMemoryARGB->unlock();
+                            endFrame(*area.sharedMemory, area.ring, frameNumber);
                             // Wake up any pending processes.
-                            sharedMemoryARGB->notifyAll();
+                            area.sharedMemory->notifyAll();
                         }
+                    }
+                }
 
+                // Scale the pyramid levels down from the I420 frame, each from the level above.
+                {
+                    const char *src{i420};
+                    for (auto &area : pyramidAreas) {
+                        if (!area.wanted) {
+                            break;
+                        }
+                        char *dst{beginFrame(*area.sharedMemory, area.ring, area.header, frameNumber, ts, nowOnHost)};
+                        stripeThreadPool.run([&](uint32_t stripe, uint32_t stripes) {
+                            uint32_t begin{0}, end{0};
+                            StripeThreadPool::rowsOfStripe(stripe, stripes, area.height, begin, end);
+                            if (MONO) {
+                                pyramid::scaleDownLuma(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst), area.width, begin, end);
+                            }
+                            else {
+                                pyramid::scaleDown(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst), area.width, area.height, begin, end);
+                            }
+                        });
+                        endFrame(*area.sharedMemory, area.ring, frameNumber);
                         // Wake up any pending processes.
-                        sharedMemoryI420->notifyAll();
+                        area.sharedMemory->notifyAll();
+                        src = dst;
+                    }
+                }
+
+                if (nullptr != frameSetAssembler) {
+                    // Frame sets are matched by the camera's PTP time stamps.
+                    frameSetAssembler->offer(cameraIndex, grabbedFrame.cameraTimeStampInMicroseconds, i420);
+                }
+
+                notifyReaders(*sharedMemoryI420);
+
+                const auto conversionDone{std::chrono::steady_clock::now()};
+                latencies[CONVERSION].record(std::chrono::duration_cast<std::chrono::microseconds>(conversionDone - conversionStart).count());
+                statistics.conversionTimeInMicroseconds.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(conversionDone - conversionStart).count()), std::memory_order_relaxed);
+                statistics.conversions.fetch_add(1, std::memory_order_relaxed);
+                if ( (0 <= numaNode) && !CPU_ISSET(sched_getcpu(), &cpusOfNumaNode) ) {
+                    remoteConversions.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (1 == statistics.conversions.load(std::memory_order_relaxed)) {
+                    std::clog << "[opendlv-device-camera-pylon]: First frame of camera '" << CAMERA << "' published " << std::chrono::duration_cast<std::chrono::milliseconds>(conversionDone - grabbingStarted).count() << " ms after the start of grabbing (conversion: " << std::chrono::duration_cast<std::chrono::microseconds>(conversionDone - conversionStart).count() << " us)." << std::endl;
+                }
+                if (INFO) {
+                    if (BAYER) {
+                        std::cout << "[opendlv-device-camera-pylon]: Demosaiced frame (" << bayer::kernelName() << ") using " << stripeThreadPool.stripes() << " thread(s) in " << std::chrono::duration_cast<std::chrono::microseconds>(conversionI420Done - conversionStart).count() << " us" << std::endl;
+                    }
+                    else if (FUSED) {
+                        std::cout << "[opendlv-device-camera-pylon]: Converted frame (fused, " << yuyv::kernelName() << ") using " << stripeThreadPool.stripes() << " thread(s) in " << std::chrono::duration_cast<std::chrono::microseconds>(conversionI420Done - conversionStart).count() << " us" << std::endl;
                     }
                     else {
-                        std::cout << "Error: " << ptrGrabResult->GetErrorCode() << " " << ptrGrabResult->GetErrorDescription() << std::endl;
+                        std::cout << "[opendlv-device-camera-pylon]: Converted frame using " << stripeThreadPool.stripes() << " thread(s) in " << std::chrono::duration_cast<std::chrono::microseconds>(conversionDone - conversionStart).count() << " us (I420: " << std::chrono::duration_cast<std::chrono::microseconds>(conversionI420Done - conversionStart).count() << " us, ARGB: " << std::chrono::duration_cast<std::chrono::microseconds>(conversionDone - conversionI420Done).count() << " us)" << std::endl;
                     }
                 }
+
+                if (recorder) {
+                    // The published frame is copied for the writer; dropped if the disk cannot keep up.
+                    recorder->record(i420, timeStampInMicroseconds, cluon::time::toMicroseconds(cluon::time::now()));
+                }
+            };
+
+            // Every grabbed frame is kept by the grab thread before it is handed
+            // over, so that frames dropped from the queue are kept as well.
+            auto keepInFlightRecorder = [&flightRecorder](const GrabbedFrame &grabbedFrame) {
+                if (flightRecorder) {
+                    flightRecorder->keep(reinterpret_cast<const char*>(grabbedFrame.grabResult->GetBuffer()), grabbedFrame.sampleTimeStampInMicroseconds, cluon::time::toMicroseconds(grabbedFrame.receivedOnHost));
+                }
+            };
+
+            // The raw frame already resides in the shared memory and its slot is
+            // published by the grab thread as soon as it arrived. The grab buffer
+            // of the latest published frame is held until the next frame is
+            // published so that Pylon cannot refill it in the meantime.
+            CBaslerUniversalGrabResultPtr publishedRawFrame;
+            auto publishRawFrame = [&](const GrabbedFrame &grabbedFrame) {
+                if (nullptr == rawFrameAreaHeader) {
+                    return;
+                }
+                sharedMemoryYUYV->lock();
+                if (COMPAT_TIMESTAMP) {
+                    sharedMemoryYUYV->setTimeStamp(cluon::time::fromMicroseconds(grabbedFrame.sampleTimeStampInMicroseconds));
+                }
+                if (publishedRawFrame.IsValid()) {
+                    // Marked before its buffer can be returned to Pylon below.
+                    rawFrameAreaHeader->requeue(static_cast<uint32_t>(publishedRawFrame->GetBufferContext()));
+                }
+                rawFrameAreaHeader->publish(static_cast<uint32_t>(grabbedFrame.grabResult->GetBufferContext()), grabbedFrame.sampleTimeStampInMicroseconds, cluon::time::toMicroseconds(grabbedFrame.receivedOnHost));
+                sharedMemoryYUYV->unlock();
+                // Wake up any pending processes.
+                sharedMemoryYUYV->notifyAll();
+                publishedRawFrame = grabbedFrame.grabResult;
+            };
+
+            // In pipeline mode, a separate thread converts the frames that
+            // are handed over from the grab loop below.
+            std::unique_ptr<FrameQueue<GrabbedFrame> > frameQueue{nullptr};
+            std::thread conversionWorker;
+            ThreadJoiner conversionWorkerJoiner{conversionWorker, [&]() {
+                conversionWorkerDone.store(true);
+                frameQueue->close();
+            }};
+            if (PIPELINE) {
+                frameQueue.reset(new FrameQueue<GrabbedFrame>{QUEUE_SIZE, QUEUE_POLICY});
+                conversionWorker = std::thread([&]() {
+                    configureThread(pthread_self(), "conversion", REALTIME_PRIORITY - 1, !CPUS_CONVERSION.empty() ? CPUS_CONVERSION[0] : -1);
+                    GrabbedFrame grabbedFrame;
+                    while (od4.isRunning() && !conversionWorkerDone.load()) {
+                        if (frameQueue->pop(grabbedFrame, std::chrono::milliseconds(100))) {
+                            try {
+                                processGrabResult(grabbedFrame);
+                            }
+                            catch (const GenericException &e) {
+                                std::cerr << "[opendlv-device-camera-pylon]: Exception in conversion thread: '" << e.GetDescription() << "'." << std::endl;
+                            }
+                            // Return the buffer to Pylon as early as possible.
+                            grabbedFrame.grabResult.Release();
+                        }
+                    }
+                });
+                std::clog << "[opendlv-device-camera-pylon]: Pipeline mode with queue size " << frameQueue->capacity() << " (" << ((FrameQueue<GrabbedFrame>::OverflowPolicy::BLOCK == QUEUE_POLICY) ? "block" : "drop-oldest") << ")." << std::endl;
             }
-            catch (const GenericException &e) {
-                std::cerr << "[opendlv-device-camera-pylon]: Exception: '" << e.GetDescription() << "'." << std::endl;
-                return -1;
+
+            auto printQueueStatistics = [&frameQueue]() {
+                if (frameQueue) {
+                    std::clog << "[opendlv-device-camera-pylon]: Queue depth: " << frameQueue->depth() << "/" << frameQueue->capacity() << ", max depth: " << frameQueue->maxDepth() << ", frames: " << frameQueue->pushed() << ", drops: " << frameQueue->drops() << std::endl;
+                }
+            };
+            auto printRecorderStatistics = [&recorder, &CAMERA]() {
+                if (recorder) {
+                    std::clog << "[opendlv-device-camera-pylon]: Recording of camera '" << CAMERA << "': " << recorder->frames() << " frames written, " << recorder->depth() << " queued (max: " << recorder->maxDepth() << "/" << recorder->capacity() << "), " << recorder->drops() << " dropped, " << (recorder->bytes() >> 20) << " MB at " << static_cast<uint64_t>(recorder->throughput() / (1024.0 * 1024.0)) << " MB/s, " << recorder->failedWrites() << " failed writes." << std::endl;
+                }
+            };
+
+            // Map the camera's time stamps to host time; the PTP state is
+            // checked periodically as the camera's clock jumps when PTP locks.
+            CameraClockModel clockModel{CLOCK_WINDOW};
+            auto isPTPLocked = [&camera]() {
+                try {
+                    if (camera.GevIEEE1588DataSetLatch.IsWritable()) {
+                        camera.GevIEEE1588DataSetLatch.Execute();
+                        const auto status = camera.GevIEEE1588StatusLatched.GetValue();
+                        return (Basler_UniversalCameraParams::GevIEEE1588StatusLatched_Slave == status) || (Basler_UniversalCameraParams::GevIEEE1588StatusLatched_Master == status);
+                    }
+                    if (camera.GevIEEE1588Status.IsReadable()) {
+                        const auto status = camera.GevIEEE1588Status.GetValue();
+                        return (Basler_UniversalCameraParams::GevIEEE1588Status_Slave == status) || (Basler_UniversalCameraParams::GevIEEE1588Status_Master == status);
+                    }
+                }
+                catch (const GenericException &) {
+                    // The camera does not support PTP.
+                }
+                return false;
+            };
+            // The PTP state as last polled, and the state the clock model was started for.
+            std::atomic<bool> ptpLocked{isPTPLocked()};
+            bool clockModelLocked{ptpLocked.load()};
+            auto checkClock = [&]() {
+                const bool locked{ptpLocked.load(std::memory_order_relaxed)};
+                if (locked != clockModelLocked) {
+                    std::clog << "[opendlv-device-camera-pylon]: PTP " << (locked ? "locked" : "not locked") << "." << std::endl;
+                    clockModelLocked = locked;
+                    clockModel.reset();
+                }
+            };
+            auto printClockStatistics = [&]() {
+                std::clog << "[opendlv-device-camera-pylon]: Clock model: " << (clockModel.isValid() ? "valid" : "not valid") << ", PTP: " << (clockModelLocked ? "locked" : "not locked") << ", camera clock: " << clockModel.ticksPerMicrosecond() << " ticks/us, jitter RMS: " << clockModel.residualRMSInMicroseconds() << " us, max: " << clockModel.residualMaxInMicroseconds() << " us, inliers: " << clockModel.inliers() << "/" << clockModel.samples() << ", resets: " << clockModel.resets() << std::endl;
+            };
+            if (CLOCK_MODEL) {
+                if (!clockModelLocked) {
+                    std::clog << "[opendlv-device-camera-pylon]: PTP not locked; mapping the camera's free-running clock to host time." << std::endl;
+                }
+            }
+
+            // Latching and reading the PTP registers is a round-trip to the camera
+            // of several milliseconds; a thread without real-time priority polls
+            // them every five seconds so that the grab loop only reads the result.
+            std::mutex ptpMonitorMutex;
+            std::condition_variable ptpMonitorCondition;
+            bool ptpMonitorDone{false};
+            std::thread ptpMonitor;
+            ThreadJoiner ptpMonitorJoiner{ptpMonitor, [&]() {
+                std::lock_guard<std::mutex> lck(ptpMonitorMutex);
+                ptpMonitorDone = true;
+                ptpMonitorCondition.notify_all();
+            }};
+            ptpMonitor = std::thread([&]() {
+                realtime::setAffinity(pthread_self(), CPUS_OF_PROCESS);
+                std::unique_lock<std::mutex> lck(ptpMonitorMutex);
+                while (!ptpMonitorCondition.wait_for(lck, std::chrono::seconds(5), [&ptpMonitorDone]() { return ptpMonitorDone; })) {
+                    lck.unlock();
+                    ptpLocked.store(isPTPLocked(), std::memory_order_relaxed);
+                    lck.lock();
+                }
+            });
+
+            // Frame grabbing loop.
+            const uint32_t timeoutInMS{10000};
+            cluon::data::TimeStamp lastStatistics{cluon::time::now()};
+            cluon::data::TimeStamp lastLatencyExport{cluon::time::now()};
+            std::vector<uint64_t> latencyCounts;
+            std::vector<uint64_t> exportedLatencyCounts[LATENCY_STAGES];
+            for (auto &counts : exportedLatencyCounts) {
+                counts.assign(LatencyHistogram::BUCKETS, 0);
             }
+            uint32_t latencyDumps{latencyDumpRequests.load()};
 
-            // Release any resources.
+            // Frames lost on the way to the host are detected by gaps in the block IDs.
+            const uint64_t NO_BLOCK_ID{0xFFFFFFFFFFFFFFFFull};
+            const uint32_t BUFFER_INCOMPLETE{0xE1000014};
+            uint64_t lastBlockId{NO_BLOCK_ID};
+            uint64_t publishedLoss{0};
+            cluon::data::TimeStamp lastLossReport{cluon::time::now()};
+            auto publishLoss = [&]() {
+                const uint64_t LOST{statistics.lostFrames.load(std::memory_order_relaxed)};
+                const uint64_t SKIPPED{statistics.skippedImages.load(std::memory_order_relaxed)};
+                const uint64_t INCOMPLETE{statistics.incompleteFrames.load(std::memory_order_relaxed)};
+                const uint64_t FAILED{statistics.failedGrabs.load(std::memory_order_relaxed)};
+                const uint64_t DROPPED{frameQueue ? frameQueue->drops() : 0};
+                const uint64_t LOSS{LOST + SKIPPED + FAILED + DROPPED};
+                if (LOSS == publishedLoss) {
+                    return;
+                }
+                for (auto counters : lossCounters) {
+                    counters->lostFrames.store(LOST, std::memory_order_relaxed);
+                    counters->skippedImages.store(SKIPPED, std::memory_order_relaxed);
+                    counters->incompleteFrames.store(INCOMPLETE, std::memory_order_relaxed);
+                    counters->failedGrabs.store(FAILED, std::memory_order_relaxed);
+                    counters->droppedFrames.store(DROPPED, std::memory_order_relaxed);
+                }
+                // Report on OD4 at most once per second.
+                if (1000 * 1000 < cluon::time::deltaInMicroseconds(cluon::time::now(), lastLossReport)) {
+                    std::stringstream sstr;
+                    sstr << "frame loss: frames: " << statistics.frames.load(std::memory_order_relaxed) << ", lost: " << LOST << ", skipped: " << SKIPPED << ", incomplete: " << INCOMPLETE << ", failed: " << FAILED << ", dropped: " << DROPPED;
+                    opendlv::system::SignalStatusMessage ssm;
+                    ssm.code(0);
+                    ssm.description(sstr.str());
+                    od4.send(ssm, cluon::time::now(), ID);
+                    lastLossReport = cluon::time::now();
+                    publishedLoss = LOSS;
+                }
+            };
+
+            while (od4.isRunning() && camera.IsGrabbing()) {
+                // This smart pointer will receive the grab result data.
+                CBaslerUniversalGrabResultPtr ptrGrabResult;
+
+                // Wait for an image and then retrieve it. A timeout of 5000 ms is used.
+                camera.RetrieveResult(timeoutInMS, ptrGrabResult, TimeoutHandling_ThrowException);
+                const cluon::data::TimeStamp receivedOnHost{cluon::time::now()};
+
+                const uint64_t BLOCK_ID{ptrGrabResult->GetBlockID()};
+                if ( (NO_BLOCK_ID != BLOCK_ID) && (NO_BLOCK_ID != lastBlockId) ) {
+                    statistics.lostFrames.fetch_add(framesMissingBetween(lastBlockId, BLOCK_ID), std::memory_order_relaxed);
+                }
+                lastBlockId = BLOCK_ID;
+                statistics.skippedImages.fetch_add(static_cast<uint64_t>(std::max<int64_t>(0, ptrGrabResult->GetNumberOfSkippedImages())), std::memory_order_relaxed);
+
+                // Image grabbed successfully?
+                if (ptrGrabResult->GrabSucceeded()) {
+                    statistics.frames.fetch_add(1, std::memory_order_relaxed);
+
+                    GrabbedFrame grabbedFrame;
+                    grabbedFrame.receivedOnHost = receivedOnHost;
+                    const uint64_t TICKS{ptrGrabResult->ChunkTimestamp.IsReadable() ? static_cast<uint64_t>(ptrGrabResult->ChunkTimestamp.GetValue()) : static_cast<uint64_t>(ptrGrabResult->GetTimeStamp())};
+                    grabbedFrame.cameraTimeStampInMicroseconds = static_cast<int64_t>(TICKS / 1000);
+                    if (clockModelLocked) {
+                        // Camera and host share the PTP time base.
+                        const int64_t EXPOSURE_TIME{ptrGrabResult->ChunkExposureTime.IsReadable() ? static_cast<int64_t>(ptrGrabResult->ChunkExposureTime.GetValue()) : 0};
+                        latencies[RETRIEVE].record(cluon::time::toMicroseconds(receivedOnHost) - grabbedFrame.cameraTimeStampInMicroseconds - EXPOSURE_TIME);
+                    }
+                    if (CLOCK_MODEL) {
+                        // Until the model is valid, the time of arrival is the best guess.
+                        clockModel.addSample(TICKS, cluon::time::toMicroseconds(receivedOnHost));
+                        grabbedFrame.sampleTimeStampInMicroseconds = clockModel.isValid() ? clockModel.toHost(TICKS) : cluon::time::toMicroseconds(receivedOnHost);
+                    }
+                    else {
+                        grabbedFrame.sampleTimeStampInMicroseconds = grabbedFrame.cameraTimeStampInMicroseconds;
+                    }
+                    grabbedFrame.grabResult = std::move(ptrGrabResult);
+                    publishRawFrame(grabbedFrame);
+                    keepInFlightRecorder(grabbedFrame);
+
+                    if (frameQueue) {
+                        frameQueue->push(std::move(grabbedFrame));
+                    }
+                    else {
+                        processGrabResult(grabbedFrame);
+                    }
+                }
+                else {
+                    statistics.failedGrabs.fetch_add(1, std::memory_order_relaxed);
+                    if (BUFFER_INCOMPLETE == static_cast<uint32_t>(ptrGrabResult->GetErrorCode())) {
+                        statistics.incompleteFrames.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    std::cout << "Error: " << ptrGrabResult->GetErrorCode() << " " << ptrGrabResult->GetErrorDescription() << std::endl;
+                }
+                publishLoss();
+
+                checkClock();
+
+                if ( (0 < LATENCY_EXPORT) && (static_cast<int64_t>(LATENCY_EXPORT) * 1000 * 1000 < cluon::time::deltaInMicroseconds(cluon::time::now(), lastLatencyExport)) ) {
+                    // Export the latencies of the last interval per stage.
+                    for (uint32_t stage{0}; stage < LATENCY_STAGES; stage++) {
+                        latencies[stage].snapshot(latencyCounts);
+                        for (uint32_t i{0}; i < LatencyHistogram::BUCKETS; i++) {
+                            std::swap(latencyCounts[i], exportedLatencyCounts[stage][i]);
+                            latencyCounts[i] = exportedLatencyCounts[stage][i] - latencyCounts[i];
+                        }
+                        opendlv::system::SignalStatusMessage ssm;
+                        ssm.code(static_cast<int32_t>(stage + 1));
+                        ssm.description(std::string{LATENCY_STAGE_NAMES[stage]} + ": " + describeLatency(latencyCounts));
+                        od4.send(ssm, cluon::time::now(), ID);
+                    }
+                    lastLatencyExport = cluon::time::now();
+                }
+
+                if (latencyDumps != latencyDumpRequests.load()) {
+                    latencyDumps = latencyDumpRequests.load();
+                    for (uint32_t stage{0}; stage < LATENCY_STAGES; stage++) {
+                        latencies[stage].snapshot(latencyCounts);
+                        std::clog << "[opendlv-device-camera-pylon]: Latency of camera '" << CAMERA << "', " << LATENCY_STAGE_NAMES[stage] << ": " << describeLatency(latencyCounts) << std::endl;
+                    }
+                }
+
+                if (INFO && (5 * 1000 * 1000 < cluon::time::deltaInMicroseconds(cluon::time::now(), lastStatistics))) {
+                    printQueueStatistics();
+                    if (frameQueue) {
+                        statistics.drops.store(frameQueue->drops(), std::memory_order_relaxed);
+                    }
+                    if (CLOCK_MODEL) {
+                        printClockStatistics();
+                    }
+                    printHugePageStatistics();
+                    printNumaStatistics();
+                    printRecorderStatistics();
+                    lastStatistics = cluon::time::now();
+                }
+            }
+
+            if (frameQueue) {
+                statistics.drops.store(frameQueue->drops(), std::memory_order_relaxed);
+                conversionWorkerDone.store(true);
+                frameQueue->close();
+                if (conversionWorker.joinable()) {
+                    conversionWorker.join();
+                }
+                printQueueStatistics();
+            }
+            printRecorderStatistics();
+            {
+                std::lock_guard<std::mutex> lck(ptpMonitorMutex);
+                ptpMonitorDone = true;
+                ptpMonitorCondition.notify_all();
+            }
+            if (ptpMonitor.joinable()) {
+                ptpMonitor.join();
+            }
+            schedulingMonitorDone.store(true);
+            if (schedulingMonitor.joinable()) {
+                schedulingMonitor.join();
+            }
+        }
+        catch (const GenericException &e) {
+            std::cerr << "[opendlv-device-camera-pylon]: Exception: '" << e.GetDescription() << "'." << std::endl;
+            if (flightRecorder && FLIGHT_RECORDER_ON_ERROR) {
+                // The frames up to a timeout or a lost camera; written before the flight recorder is destroyed.
+                flightRecorder->dump();
+            }
+            return -1;
         }
-        retCode = 0;
+
+        // Release any resources.
     }
     return retCode;
 }
 
+int32_t main(int32_t argc, char **argv) {
+    // Automatic initialization and cleanup.
+    Pylon::PylonAutoInitTerm autoInitTerm;
+
+    int32_t retCode{0};
+    auto commandlineArguments = cluon::getCommandlineArguments(argc, argv);
+    if ( (0 == commandlineArguments.count("cid")) ||
+         (0 == commandlineArguments.count("camera")) ||
+         (0 == commandlineArguments.count("width")) ||
+         (0 == commandlineArguments.count("height")) ) {
+        std::cerr << argv[0] << " interfaces with a Pylon camera (given by the numerical identifier, e.g., 0) and provides the captured image in two shared memory areas: one in I420 format and one in ARGB format." << std::endl;
+        std::cerr << "Usage:   " << argv[0] << " --camera=<identifier> --width=<width> --height=<height> [--name.i420=<unique name for the shared memory in I420 format>] [--name.argb=<unique name for the shared memory in ARGB format>] --width=W --height=H [--offsetX=X] [--offsetY=Y] [--packetsize=1500] [--fps=17] [--verbose]" << std::endl;
+        std::cerr << "         --cid:    CID of the OD4Session to send and receive messages" << std::endl;
+        std::cerr << "         --id:     ID to use as senderStamp for sending" << std::endl;
+        std::cerr << "         --camera:     serial number for Pylon-compatible camera to be used; a comma-separated list drives several cameras from this process, each with its own grab thread" << std::endl;
+        std::cerr << "                       with several cameras, --id, --name.i420, --name.argb, and --name.yuyv take one comma-separated value per camera, --output and --name.pyramid one ';'-separated list per camera," << std::endl;
+        std::cerr << "                       and --width, --height, --offsetX, --offsetY, --packetsize, --fps, and --pixelformat one value for all or one per camera; --id defaults to the camera's index and the names to 'video<index>.i420' and 'video<index>.argb'" << std::endl;
+        std::cerr << "         --name.i420:  name of the shared memory for the I420 formatted image; when omitted, 'video0.i420' is chosen" << std::endl;
+        std::cerr << "         --name.argb:  name of the shared memory for the I420 formatted image; when omitted, 'video0.argb' is chosen" << std::endl;
+        std::cerr << "         --skip.argb:  don't decode frame into argb format; default: false" << std::endl;
+        std::cerr << "         --slots:      when given, keep the last N frames in a ring of slots with sequence numbers in the I420 and ARGB shared memory areas" << std::endl;
+        std::cerr << "         --publish:    publish frames with lock (producer locks the shared memory) or seqlock (lock-free single slot with sequence number) (default: lock)" << std::endl;
+        std::cerr << "         --compat.timestamp: store the frame's time stamp via the shared memory's file time stamp and keep the frames at the beginning of the I420 and ARGB areas as in earlier versions" << std::endl;
+        std::cerr << "         --on-demand:  only convert into the I420 and ARGB areas while a reader is registered in the respective area" << std::endl;
+        std::cerr << "         --on-demand.timeout: time in ms after which a reader without heartbeat is no longer considered (default: 1000)" << std::endl;
+        std::cerr << "         --output:     additional outputs as comma-separated list of format:name with format being nv12, bgr24, rgb24, gray, or rgbp (planar RGB)" << std::endl;
+        std::cerr << "         --pyramid:    publish additional I420 frames at half, quarter, and eighth resolution for 1, 2, or 3 levels" << std::endl;
+        std::cerr << "         --name.pyramid: comma-separated names of the shared memory for the pyramid levels; when omitted, the name of the I420 area with '.half', '.quarter', and '.eighth' appended is chosen" << std::endl;
+        std::cerr << "         --name.yuyv:  when given, let the camera place the raw YUYV frames directly into a ring of slots in the shared memory with this name" << std::endl;
+        std::cerr << "         --frameset:   name of the shared memory for sets of I420 frames of all cameras whose time stamps are within --frameset.tolerance" << std::endl;
+        std::cerr << "         --frameset.tolerance: maximum difference in us between the time stamps of the frames in a set (default: 1000)" << std::endl;
+        std::cerr << "         --width:      desired width of a frame" << std::endl;
+        std::cerr << "         --height:     desired height of a frame" << std::endl;
+        std::cerr << "         --offsetX:    X for desired ROI (default: 0)" << std::endl;
+        std::cerr << "         --offsetY:    Y for desired ROI (default: 0)" << std::endl;
+        std::cerr << "         --packetsize: if supported by the adapter (eg., jumbo frames), use this packetsize (default: 1500)" << std::endl;
+        std::cerr << "         --autoexposuretimeabslowerlimit: default: 26" << std::endl;
+        std::cerr << "         --autoexposuretimeabsupperlimit: default: 50000" << std::endl;
+        std::cerr << "         --fps:        desired acquisition frame rate (depends on bandwidth)" << std::endl;
+        std::cerr << "         --sync:       force all cameras to capture in sync (lowers frame rate)" << std::endl;
+        std::cerr << "         --verbose:    display captured image in a window that is updated from a separate thread via MIT-SHM" << std::endl;
+        std::cerr << "         --verbose.fps: maximum rate to update the window (default: 10)" << std::endl;
+        std::cerr << "         --verbose.scale: divisor for the size of the window, e.g., 2 for half width and height (default: 1)" << std::endl;
+        std::cerr << "         --rec:        record the I420 frames as opendlv.proxy.ImageReading into this .rec file from a background thread" << std::endl;
+        std::cerr << "         --rec.queue:  number of frames to buffer for the recording; frames are dropped when the disk cannot keep up (default: 16)" << std::endl;
+        std::cerr << "         --flightrecorder: keep the raw frames of the last S seconds in memory; SIGUSR2 or cluon.data.RecorderCommand (command 1) writes them to a .rec file (default: 0, i.e., off)" << std::endl;
+        std::cerr << "         --flightrecorder.dir: directory for the .rec files of the flight recorder (default: .)" << std::endl;
+        std::cerr << "         --flightrecorder.onerror: also write the flight recorder's frames when grabbing stops because of an error" << std::endl;
+        std::cerr << "         --info:       show grabbing information " << std::endl;
+        std::cerr << "         --timestamp:  publish frames with time stamps in host time mapped from the camera's clock (model) or with the camera's time stamps (camera) (default: model)" << std::endl;
+        std::cerr << "         --clock.window: number of frames to fit the mapping from the camera's clock to host time to (default: 128)" << std::endl;
+        std::cerr << "         --latency.export: interval in s to send the latency percentiles of the pipeline stages as opendlv.system.SignalStatusMessage (default: 0, i.e., off); SIGUSR1 dumps them" << std::endl;
+        std::cerr << "         --pipeline:   grab and convert frames in separate threads" << std::endl;
+        std::cerr << "         --queue.size: number of grabbed frames to buffer between grab and conversion thread in pipeline mode (default: 4)" << std::endl;
+        std::cerr << "         --queue.policy: behavior for a full queue in pipeline mode: drop-oldest or block (default: drop-oldest)" << std::endl;
+        std::cerr << "         --threads:    number of threads to convert a frame in horizontal stripes (default: 1)" << std::endl;
+        std::cerr << "         --pixelformat: pixel format to grab: yuyv, or bayerrg8, bayerbg8, bayergr8, bayergb8 for 8 bit Bayer frames that are demosaiced on the host, or mono8 for monochrome cameras;" << std::endl;
+        std::cerr << "                         mono10p, mono12p, bayerrg10p, bayerrg12p (and the other Bayer patterns) for packed 10/12 bit frames that are unpacked into a 16 bit area and tone mapped into I420 and ARGB; default: yuyv" << std::endl;
+        std::cerr << "         --name.raw16: name of the shared memory for the unpacked 16 bit frames of packed pixel formats; when omitted, the name of the I420 area with '.raw16' appended is chosen" << std::endl;
+        std::cerr << "         --tonemap.gamma: gamma to map packed 10/12 bit frames into 8 bit for I420 and ARGB; default: 2.2" << std::endl;
+        std::cerr << "         --fused:      convert a frame to I420 and ARGB in a single pass instead of using libyuv" << std::endl;
+        std::cerr << "         --hugepages:  back the shared memory areas with 2 MB transparent huge pages if /sys/kernel/mm/transparent_hugepage/shmem_enabled allows it" << std::endl;
+        std::cerr << "         --warmup:     fault in and lock all shared memory areas and grab buffers and convert a blank frame before grabbing (implied by --realtime)" << std::endl;
+        std::cerr << "         --numa:       bind the grab buffers, shared memory areas, and threads of a camera to the NUMA node of its network interface (--numa=auto) or to the given node (--numa=N)" << std::endl;
+        std::cerr << "         --realtime:   run Pylon's receive thread, the grab thread, and the conversion threads with SCHED_FIFO, lock all memory, and prefault the shared memory areas (needs CAP_SYS_NICE and CAP_IPC_LOCK)" << std::endl;
+        std::cerr << "         --realtime.priority: SCHED_FIFO priority of the grab thread; the receive thread runs one above and the conversion threads one below (default: 50)" << std::endl;
+        std::cerr << "         --cpu.grab:   CPU to pin the grab thread to" << std::endl;
+        std::cerr << "         --cpu.receive: CPU to pin Pylon's receive thread to" << std::endl;
+        std::cerr << "         --cpu.conversion: comma-separated CPUs to pin the conversion threads to (the pipeline worker first, then the stripe threads); use ';' to separate the lists of several cameras" << std::endl;
+        std::cerr << "         --cpu.monitor: with --realtime, measure the scheduling latency on this CPU every millisecond (latency stage 5)" << std::endl;
+        std::cerr << "Example: " << argv[0] << " --camera=0 --width=640 --height=480 --verbose" << std::endl;
+        retCode = 1;
+    }
+    else {
+        std::vector<std::string> cameras;
+        {
+            std::stringstream sstr{commandlineArguments["camera"]};
+            std::string camera;
+            while (std::getline(sstr, camera, ',')) {
+                cameras.push_back(camera);
+            }
+        }
+        const uint32_t CAMERAS{static_cast<uint32_t>(cameras.size())};
+        if (0 == CAMERAS) {
+            std::cerr << "[opendlv-device-camera-pylon]: No camera given." << std::endl;
+            return retCode = 1;
+        }
+        const bool INFO{commandlineArguments.count("info") != 0};
+
+        std::vector<std::map<std::string, std::string> > cameraArguments(CAMERAS);
+        for (uint32_t i{0}; i < CAMERAS; i++) {
+            if (!selectCameraArguments(commandlineArguments, i, CAMERAS, cameraArguments[i])) {
+                return retCode = 1;
+            }
+        }
+
+        if ( (commandlineArguments.count("realtime") != 0) && !realtime::lockMemory() ) {
+            std::cerr << "[opendlv-device-camera-pylon]: Failed to lock the memory (" << std::strerror(errno) << "); page faults may delay frames." << std::endl;
+        }
+
+        cluon::OD4Session od4{static_cast<uint16_t>(std::stoi(commandlineArguments["cid"]))};
+        std::signal(SIGUSR1, requestLatencyDump);
+        if (commandlineArguments.count("flightrecorder") != 0) {
+            std::signal(SIGUSR2, requestFlightRecorderDump);
+            od4.dataTrigger(cluon::data::RecorderCommand::ID(), [](cluon::data::Envelope &&envelope) {
+                if (1 == cluon::extractMessage<cluon::data::RecorderCommand>(std::move(envelope)).command()) {
+                    requestFlightRecorderDump(0);
+                }
+            });
+        }
+
+        // Enumerate the devices once for all cameras.
+        DeviceInfoList_t lstDevices;
+        try {
+            CTlFactory::GetInstance().EnumerateDevices(lstDevices);
+        }
+        catch (const GenericException &e) {
+            std::cerr << "[opendlv-device-camera-pylon]: Exception: '" << e.GetDescription() << "'." << std::endl;
+            return retCode = -1;
+        }
+        for (const auto &device : lstDevices) {
+            std::clog << "[opendlv-device-camera-pylon]: " << device.GetModelName() << " (" << device.GetSerialNumber() << ") at " << device.GetIpAddress() << std::endl;
+        }
+
+        // Frames of all cameras matched by their time stamps into sets in one area.
+        std::unique_ptr<cluon::SharedMemory> sharedMemoryFrameSet{nullptr};
+        FrameSetHeader *frameSetHeader{nullptr};
+        std::unique_ptr<FrameSetAssembler> frameSetAssembler{nullptr};
+        if (commandlineArguments.count("frameset") != 0) {
+            if (FrameSetHeader::MAX_CAMERAS < CAMERAS) {
+                std::cerr << "[opendlv-device-camera-pylon]: --frameset supports up to " << FrameSetHeader::MAX_CAMERAS << " cameras." << std::endl;
+                return retCode = 1;
+            }
+            const int64_t TOLERANCE{static_cast<int64_t>((commandlineArguments.count("frameset.tolerance") != 0) ? std::stoi(commandlineArguments["frameset.tolerance"]) : 1000)};
+            // The sets being assembled, the latest complete set, and one spare slot
+            // per camera for sets still being copied into when they are abandoned.
+            const uint32_t SET_SLOTS{FrameSetAssembler::MAX_OPEN_SETS + 1 + CAMERAS};
+            std::vector<uint32_t> widths, heights, frameSizes;
+            for (auto &arguments : cameraArguments) {
+                widths.push_back(static_cast<uint32_t>(std::stoi(arguments["width"])));
+                heights.push_back(static_cast<uint32_t>(std::stoi(arguments["height"])));
+                frameSizes.push_back(widths.back() * heights.back() * 3/2);
+            }
+            sharedMemoryFrameSet.reset(new cluon::SharedMemory{commandlineArguments["frameset"], FrameSetHeader::sizeOfArea(SET_SLOTS, frameSizes.data(), CAMERAS)});
+            if (!sharedMemoryFrameSet->valid()) {
+                std::cerr << "[opendlv-device-camera-pylon]: Failed to create shared memory '" << commandlineArguments["frameset"] << "'." << std::endl;
+                return retCode = 1;
+            }
+            if ( (commandlineArguments.count("hugepages") != 0) && (hugepages::PAGE_SIZE <= sharedMemoryFrameSet->size()) ) {
+                hugepages::advise(sharedMemoryFrameSet->data(), sharedMemoryFrameSet->size());
+            }
+            sharedMemoryFrameSet->lock();
+            {
+                frameSetHeader = FrameSetHeader::create(sharedMemoryFrameSet->data(), CAMERAS, widths.data(), heights.data(), frameSizes.data(), SET_SLOTS, TOLERANCE);
+            }
+            sharedMemoryFrameSet->unlock();
+            frameSetAssembler.reset(new FrameSetAssembler{frameSetHeader, [&sharedMemoryFrameSet]() {
+                // Wake up any pending processes.
+                sharedMemoryFrameSet->notifyAll();
+            }});
+            std::clog << "[opendlv-device-camera-pylon]: Sets of I420 frames of " << CAMERAS << " camera(s) within " << TOLERANCE << " us available in shared memory '" << sharedMemoryFrameSet->name() << "' (" << sharedMemoryFrameSet->size() << ")." << std::endl;
+        }
+        auto printFrameSetStatistics = [&frameSetHeader]() {
+            if (nullptr != frameSetHeader) {
+                std::clog << "[opendlv-device-camera-pylon]: Frame sets: complete: " << frameSetHeader->completeSets.load(std::memory_order_relaxed) << ", incomplete: " << frameSetHeader->incompleteSets.load(std::memory_order_relaxed) << ", late frames: " << frameSetHeader->lateFrames.load(std::memory_order_relaxed) << ", dropped frames: " << frameSetHeader->droppedFrames.load(std::memory_order_relaxed) << std::endl;
+            }
+        };
+
+        std::unique_ptr<CameraStatistics[]> statistics(new CameraStatistics[CAMERAS]);
+        if (1 == CAMERAS) {
+            retCode = runCamera(cameraArguments[0], lstDevices, od4, statistics[0], 0, frameSetAssembler.get());
+            printFrameSetStatistics();
+        }
+        else {
+            if (commandlineArguments.count("verbose") != 0) {
+                // Every preview thread opens its own display connection.
+                XInitThreads();
+            }
+            // Every camera has its own grab thread and conversion workers.
+            std::vector<int32_t> retCodes(CAMERAS, 0);
+            std::atomic<uint32_t> running{CAMERAS};
+            std::vector<std::thread> grabThreads;
+            for (uint32_t i{0}; i < CAMERAS; i++) {
+                grabThreads.emplace_back(std::thread([&, i]() {
+                    retCodes[i] = runCamera(cameraArguments[i], lstDevices, od4, statistics[i], i, frameSetAssembler.get());
+                    if (0 != retCodes[i]) {
+                        std::cerr << "[opendlv-device-camera-pylon]: Camera '" << cameras[i] << "' stopped with " << retCodes[i] << "." << std::endl;
+                    }
+                    running.fetch_sub(1);
+                }));
+            }
+
+            auto printStatistics = [&]() {
+                uint64_t frames{0}, failedGrabs{0}, drops{0}, lostFrames{0}, skippedImages{0}, conversions{0}, conversionTime{0};
+                for (uint32_t i{0}; i < CAMERAS; i++) {
+                    const uint64_t CONVERSIONS{statistics[i].conversions.load(std::memory_order_relaxed)};
+                    const uint64_t CONVERSION_TIME{statistics[i].conversionTimeInMicroseconds.load(std::memory_order_relaxed)};
+                    std::clog << "[opendlv-device-camera-pylon]: Camera '" << cameras[i] << "': frames: " << statistics[i].frames.load(std::memory_order_relaxed) << ", failed: " << statistics[i].failedGrabs.load(std::memory_order_relaxed) << ", drops: " << statistics[i].drops.load(std::memory_order_relaxed) << ", lost: " << statistics[i].lostFrames.load(std::memory_order_relaxed) << ", skipped: " << statistics[i].skippedImages.load(std::memory_order_relaxed) << ", avg. conversion: " << ((0 < CONVERSIONS) ? CONVERSION_TIME / CONVERSIONS : 0) << " us" << std::endl;
+                    frames += statistics[i].frames.load(std::memory_order_relaxed);
+                    failedGrabs += statistics[i].failedGrabs.load(std::memory_order_relaxed);
+                    drops += statistics[i].drops.load(std::memory_order_relaxed);
+                    lostFrames += statistics[i].lostFrames.load(std::memory_order_relaxed);
+                    skippedImages += statistics[i].skippedImages.load(std::memory_order_relaxed);
+                    conversions += CONVERSIONS;
+                    conversionTime += CONVERSION_TIME;
+                }
+                std::clog << "[opendlv-device-camera-pylon]: All " << CAMERAS << " cameras: frames: " << frames << ", failed: " << failedGrabs << ", drops: " << drops << ", lost: " << lostFrames << ", skipped: " << skippedImages << ", avg. conversion: " << ((0 < conversions) ? conversionTime / conversions : 0) << " us" << std::endl;
+                printFrameSetStatistics();
+            };
+
+            cluon::data::TimeStamp lastStatistics{cluon::time::now()};
+            while (0 < running.load()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                if (INFO && (5 * 1000 * 1000 < cluon::time::deltaInMicroseconds(cluon::time::now(), lastStatistics))) {
+                    printStatistics();
+                    lastStatistics = cluon::time::now();
+                }
+            }
+            for (auto &t : grabThreads) {
+                t.join();
+            }
+            printStatistics();
+            for (auto r : retCodes) {
+                retCode = (0 != retCode) ? retCode : r;
+            }
+        }
+    }
+    return retCode;
+}
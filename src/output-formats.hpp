@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUT_FORMATS_HPP
+#define OUTPUT_FORMATS_HPP
+
+#include <libyuv.h>
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Additional output formats that can be published next to I420 and ARGB.
+ *
+ * The formats form a small conversion graph: GRAY8 is taken from the luma of
+ * the grabbed YUYV frame (or copied from the Y plane of the I420 frame for
+ * other pixel formats), NV12, BGR24, and RGB24 are derived from the I420
+ * frame, and planar RGB is split from an RGB24 frame, re-using an RGB24
+ * output of the same frame when there is one. The enumerators are ordered
+ * such that every format comes after the formats it may be derived from.
+ */
+namespace output {
+
+enum class Format : uint8_t {
+    GRAY  = 0,
+    NV12  = 1,
+    BGR24 = 2,
+    RGB24 = 3,
+    RGBP  = 4,
+};
+
+struct Output {
+    Format format{Format::GRAY};
+    std::string name{};
+};
+
+inline const char *formatName(Format format) noexcept {
+    switch (format) {
+        case Format::GRAY: return "gray";
+        case Format::NV12: return "nv12";
+        case Format::BGR24: return "bgr24";
+        case Format::RGB24: return "rgb24";
+        case Format::RGBP: return "rgbp";
+    }
+    return "";
+}
+
+/**
+ * @return Size in bytes of a frame in the given format.
+ */
+inline uint32_t frameSize(Format format, uint32_t width, uint32_t height) noexcept {
+    switch (format) {
+        case Format::GRAY: return width * height;
+        case Format::NV12: return width * height * 3 / 2;
+        case Format::BGR24: return width * height * 3;
+        case Format::RGB24: return width * height * 3;
+        case Format::RGBP: return width * height * 3;
+    }
+    return 0;
+}
+
+/**
+ * @return true if the format is derived from the I420 frame of a YUYV frame.
+ */
+inline bool needsI420(Format format) noexcept {
+    return Format::GRAY != format;
+}
+
+/**
+ * Parses a list of outputs like "nv12:cam0.nv12,gray:cam0.gray".
+ *
+ * @param spec List of outputs.
+ * @param outputs Parsed outputs.
+ * @return false if an entry is malformed or uses an unknown format.
+ */
+inline bool parse(const std::string &spec, std::vector<Output> &outputs) noexcept {
+    std::stringstream sstr{spec};
+    std::string entry;
+    while (std::getline(sstr, entry, ',')) {
+        const std::size_t colon{entry.find(':')};
+        if ( (std::string::npos == colon) || (colon + 1 == entry.size()) ) {
+            return false;
+        }
+        const std::string format{entry.substr(0, colon)};
+        Output o;
+        o.name = entry.substr(colon + 1);
+        bool found{false};
+        for (Format f : {Format::GRAY, Format::NV12, Format::BGR24, Format::RGB24, Format::RGBP}) {
+            if (format == formatName(f)) {
+                o.format = f;
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        outputs.push_back(o);
+    }
+    return true;
+}
+
+/**
+ * Converts the rows [beginRow, endRow) of an I420 frame into the given
+ * format; beginRow must be even.
+ *
+ * @param format Output format.
+ * @param srcY Y plane of the I420 frame (stride: width).
+ * @param srcU U plane of the I420 frame (stride: width/2).
+ * @param srcV V plane of the I420 frame (stride: width/2).
+ * @param dst Output frame.
+ * @param rgb24 For RGBP: RGB24 frame of the same I420 frame to split, or a
+ *              scratch frame to convert into first if rgb24IsValid is false.
+ * @param rgb24IsValid true if rgb24 already holds the RGB24 frame.
+ * @param width Width of the frame.
+ * @param height Height of the frame.
+ * @param beginRow First row to convert.
+ * @param endRow Row after the last row to convert.
+ */
+inline void fromI420(Format format, const uint8_t *srcY, const uint8_t *srcU, const uint8_t *srcV,
+                     uint8_t *dst, uint8_t *rgb24, bool rgb24IsValid,
+                     uint32_t width, uint32_t height, uint32_t beginRow, uint32_t endRow) noexcept {
+    const int W{static_cast<int>(width)};
+    const int ROWS{static_cast<int>(endRow - beginRow)};
+    const uint8_t *y{srcY + beginRow * width};
+    const uint8_t *u{srcU + (beginRow / 2) * (width / 2)};
+    const uint8_t *v{srcV + (beginRow / 2) * (width / 2)};
+    switch (format) {
+        case Format::NV12:
+            libyuv::I420ToNV12(y, W, u, W/2, v, W/2,
+                               dst + beginRow * width, W,
+                               dst + width * height + (beginRow / 2) * width, W,
+                               W, ROWS);
+            break;
+        case Format::BGR24:
+            // libyuv names formats by the order in a little-endian word; RGB24 is B, G, R in memory.
+            libyuv::I420ToRGB24(y, W, u, W/2, v, W/2, dst + beginRow * width * 3, W * 3, W, ROWS);
+            break;
+        case Format::RGB24:
+            // RAW is R, G, B in memory.
+            libyuv::I420ToRAW(y, W, u, W/2, v, W/2, dst + beginRow * width * 3, W * 3, W, ROWS);
+            break;
+        case Format::RGBP:
+            if (!rgb24IsValid) {
+                libyuv::I420ToRAW(y, W, u, W/2, v, W/2, rgb24 + beginRow * width * 3, W * 3, W, ROWS);
+            }
+            libyuv::SplitRGBPlane(rgb24 + beginRow * width * 3, W * 3,
+                                  dst + beginRow * width, W,
+                                  dst + width * height + beginRow * width, W,
+                                  dst + 2 * width * height + beginRow * width, W,
+                                  W, ROWS);
+            break;
+        case Format::GRAY:
+            libyuv::CopyPlane(y, W, dst + beginRow * width, W, W, ROWS);
+            break;
+    }
+}
+
+}
+
+#endif
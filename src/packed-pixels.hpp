@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACKED_PIXELS_HPP
+#define PACKED_PIXELS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+    #define PACKED_PIXELS_X86_64
+    #include <immintrin.h>
+#endif
+
+/**
+ * Unpacking of 10 and 12 bit packed pixels (GenICam PFNC formats like
+ * Mono12p or BayerRG10p) into 16 bit values and tone mapping into 8 bit.
+ *
+ * The pixels are packed without gaps, least significant bit first, i.e.,
+ * pixel i starts at bit i*bits of the row. Every pixel is extracted from
+ * the two bytes holding it by shifting its bits to the top of a 16 bit word
+ * and then down to the bottom. The AVX2 kernel does this for 16 pixels per
+ * iteration with a byte shuffle and a multiplication as variable left shift;
+ * the scalar kernel handles the remaining pixels and other CPUs.
+ */
+namespace packed {
+
+/**
+ * Scalar kernel for the pixels [begin, end) of a row.
+ */
+inline void unpackScalar(const uint8_t *src, uint32_t bits, uint16_t *dst, uint32_t begin, uint32_t end) noexcept {
+    const uint32_t MASK{(1u << bits) - 1};
+    for (uint32_t x{begin}; x < end; x++) {
+        const uint32_t BIT{x * bits};
+        const uint8_t *s{src + (BIT >> 3)};
+        dst[x] = static_cast<uint16_t>(((static_cast<uint32_t>(s[0]) | (static_cast<uint32_t>(s[1]) << 8)) >> (BIT & 7)) & MASK);
+    }
+}
+
+#ifdef PACKED_PIXELS_X86_64
+/**
+ * AVX2 kernel unpacking 16 pixels per iteration; returns the number of
+ * pixels that were unpacked.
+ */
+__attribute__((target("avx2")))
+inline uint32_t unpackAVX2(const uint8_t *src, uint32_t bits, uint16_t *dst, uint32_t width) noexcept {
+    // Every 128 bit lane unpacks 8 pixels from 'bits' bytes.
+    alignas(32) int8_t shuffle[32];
+    alignas(32) int16_t shift[16];
+    for (uint32_t i{0}; i < 8; i++) {
+        const uint32_t BIT{i * bits};
+        shuffle[2 * i] = shuffle[16 + 2 * i] = static_cast<int8_t>(BIT >> 3);
+        shuffle[2 * i + 1] = shuffle[16 + 2 * i + 1] = static_cast<int8_t>((BIT >> 3) + 1);
+        // Multiplying by 2^n shifts the pixel's bits to the top of the word.
+        shift[i] = shift[8 + i] = static_cast<int16_t>(1 << (16 - bits - (BIT & 7)));
+    }
+    const __m256i SHUFFLE{_mm256_load_si256(reinterpret_cast<const __m256i*>(shuffle))};
+    const __m256i SHIFT{_mm256_load_si256(reinterpret_cast<const __m256i*>(shift))};
+    const __m128i DOWN{_mm_cvtsi32_si128(static_cast<int>(16 - bits))};
+    const uint32_t ROW_BYTES{(width * bits + 7) / 8};
+
+    uint32_t x{0};
+    // The second lane reads 16 bytes starting 'bits' bytes in.
+    for (; (x + 16 <= width) && (x * bits / 8 + bits + 16 <= ROW_BYTES); x += 16) {
+        const uint8_t *s{src + x * bits / 8};
+        const __m256i v{_mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s))),
+                                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + bits)), 1)};
+        const __m256i words{_mm256_shuffle_epi8(v, SHUFFLE)};
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_srl_epi16(_mm256_mullo_epi16(words, SHIFT), DOWN));
+    }
+    return x;
+}
+#endif
+
+using UnpackKernel = uint32_t (*)(const uint8_t*, uint32_t, uint16_t*, uint32_t);
+
+/**
+ * @return The fastest kernel supported by this CPU or nullptr if there is none.
+ */
+inline UnpackKernel selectKernel() noexcept {
+#ifdef PACKED_PIXELS_X86_64
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &unpackAVX2;
+    }
+#endif
+    return nullptr;
+}
+
+/**
+ * @return Human-readable name of the kernel that is used on this CPU.
+ */
+inline const char *kernelName() noexcept {
+    return (nullptr != selectKernel()) ? "AVX2" : "scalar";
+}
+
+/**
+ * Unpacks a row of packed pixels.
+ *
+ * @param src Packed row.
+ * @param bits Bits per pixel (10 or 12).
+ * @param dst Row of 16 bit values.
+ * @param width Number of pixels of the row.
+ */
+inline void unpackRow(const uint8_t *src, uint32_t bits, uint16_t *dst, uint32_t width) noexcept {
+    static const UnpackKernel KERNEL{selectKernel()};
+    const uint32_t unpacked{(nullptr != KERNEL) ? KERNEL(src, bits, dst, width) : 0};
+    unpackScalar(src, bits, dst, unpacked, width);
+}
+
+/**
+ * Computes the table to map values of the given bit depth to 8 bit with a
+ * gamma curve; a gamma of 1 keeps the most significant bits.
+ */
+inline std::vector<uint8_t> toneMap(uint32_t bits, double gamma) noexcept {
+    const uint32_t MAXIMUM{(1u << bits) - 1};
+    std::vector<uint8_t> lut(MAXIMUM + 1);
+    for (uint32_t v{0}; v <= MAXIMUM; v++) {
+        lut[v] = static_cast<uint8_t>(std::lround(255.0 * std::pow(static_cast<double>(v) / MAXIMUM, 1.0 / gamma)));
+    }
+    return lut;
+}
+
+/**
+ * Maps a row of 16 bit values into 8 bit using a table from toneMap().
+ */
+inline void toneMapRow(const uint16_t *src, const uint8_t *lut, uint8_t *dst, uint32_t width) noexcept {
+    for (uint32_t x{0}; x < width; x++) {
+        dst[x] = lut[src[x]];
+    }
+}
+
+}
+
+#endif
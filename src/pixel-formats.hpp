@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIXEL_FORMATS_HPP
+#define PIXEL_FORMATS_HPP
+
+#include "bayer-converter.hpp"
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Pixel formats in which the camera can deliver the frames.
+ *
+ * Every format is selected by its name on the command line and configured
+ * on the camera by its GenICam name; kind selects the conversion into I420
+ * and ARGB. Bayer and monochrome frames with more than 8 bits per pixel are
+ * packed (PFNC, e.g., Mono12p) and unpacked on the host.
+ */
+namespace pixel {
+
+enum class Kind : uint8_t {
+    YUYV  = 0,
+    BAYER = 1,
+    MONO  = 2,
+};
+
+struct Format {
+    Kind kind{Kind::YUYV};
+    const char *name{""};
+    const char *pylonName{""};
+    bayer::Pattern pattern{bayer::Pattern::RGGB};
+    uint32_t bitsPerPixel{16};
+    // Bits per sample; 8 for YUYV.
+    uint32_t bitDepth{8};
+    // V4L2 fourcc of the frames in a .rec file; packed formats are stored
+    // unpacked into 16 bit per sample (value in the least significant bits).
+    const char *fourcc{"YUYV"};
+};
+
+constexpr Format FORMATS[]{
+    {Kind::YUYV, "yuyv", "YUV422_YUYV_Packed", bayer::Pattern::RGGB, 16, 8, "YUYV"},
+    {Kind::BAYER, "bayerrg8", "BayerRG8", bayer::Pattern::RGGB, 8, 8, "RGGB"},
+    {Kind::BAYER, "bayerbg8", "BayerBG8", bayer::Pattern::BGGR, 8, 8, "BA81"},
+    {Kind::BAYER, "bayergr8", "BayerGR8", bayer::Pattern::GRBG, 8, 8, "GRBG"},
+    {Kind::BAYER, "bayergb8", "BayerGB8", bayer::Pattern::GBRG, 8, 8, "GBRG"},
+    {Kind::MONO, "mono8", "Mono8", bayer::Pattern::RGGB, 8, 8, "GREY"},
+    {Kind::BAYER, "bayerrg10p", "BayerRG10p", bayer::Pattern::RGGB, 10, 10, "RG10"},
+    {Kind::BAYER, "bayerbg10p", "BayerBG10p", bayer::Pattern::BGGR, 10, 10, "BG10"},
+    {Kind::BAYER, "bayergr10p", "BayerGR10p", bayer::Pattern::GRBG, 10, 10, "BA10"},
+    {Kind::BAYER, "bayergb10p", "BayerGB10p", bayer::Pattern::GBRG, 10, 10, "GB10"},
+    {Kind::MONO, "mono10p", "Mono10p", bayer::Pattern::RGGB, 10, 10, "Y10 "},
+    {Kind::BAYER, "bayerrg12p", "BayerRG12p", bayer::Pattern::RGGB, 12, 12, "RG12"},
+    {Kind::BAYER, "bayerbg12p", "BayerBG12p", bayer::Pattern::BGGR, 12, 12, "BG12"},
+    {Kind::BAYER, "bayergr12p", "BayerGR12p", bayer::Pattern::GRBG, 12, 12, "BA12"},
+    {Kind::BAYER, "bayergb12p", "BayerGB12p", bayer::Pattern::GBRG, 12, 12, "GB12"},
+    {Kind::MONO, "mono12p", "Mono12p", bayer::Pattern::RGGB, 12, 12, "Y12 "},
+};
+
+/**
+ * @param name Name of the pixel format like "bayerrg8".
+ * @param format Parsed pixel format.
+ * @return false if the name is unknown.
+ */
+inline bool parse(const std::string &name, Format &format) noexcept {
+    for (const auto &f : FORMATS) {
+        if (name == f.name) {
+            format = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @return true if the samples are packed into more than 8 bits.
+ */
+inline bool isPacked(const Format &format) noexcept {
+    return 8 < format.bitDepth;
+}
+
+/**
+ * @return Multiple of pixels that a row must have to end at a byte boundary;
+ *         packed PFNC formats are a bit stream without padding at the end of
+ *         a row, e.g., a row of 10 bit pixels ends in the middle of a byte
+ *         unless its width is a multiple of 4.
+ */
+inline uint32_t widthAlignment(const Format &format) noexcept {
+    uint32_t alignment{1};
+    while (0 != (alignment * format.bitsPerPixel) % 8) {
+        alignment *= 2;
+    }
+    return alignment;
+}
+
+/**
+ * @return Bytes per row of a frame with the given width (see widthAlignment()).
+ */
+inline uint32_t stride(const Format &format, uint32_t width) noexcept {
+    return (width * format.bitsPerPixel + 7) / 8;
+}
+
+}
+
+#endif
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REALTIME_HPP
+#define REALTIME_HPP
+
+#include "latency-histogram.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Helpers to run the capture threads with real-time priorities on dedicated
+ * cores and to keep their memory resident.
+ *
+ * All functions report failure instead of throwing as the process usually
+ * needs CAP_SYS_NICE and CAP_IPC_LOCK (or matching rlimits) for them; the
+ * caller decides whether to continue without.
+ */
+namespace realtime {
+
+/**
+ * Runs the thread with SCHED_FIFO at the given priority.
+ */
+inline bool setPriority(pthread_t thread, int32_t priority) noexcept {
+    sched_param param{};
+    param.sched_priority = priority;
+    return 0 == pthread_setschedparam(thread, SCHED_FIFO, &param);
+}
+
+/**
+ * Restricts the thread to the given CPU.
+ */
+inline bool pin(pthread_t thread, int32_t cpu) noexcept {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    return 0 == pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+}
+
+/**
+ * @return CPUs the thread may run on.
+ */
+inline cpu_set_t affinity(pthread_t thread) noexcept {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    pthread_getaffinity_np(thread, sizeof(cpus), &cpus);
+    return cpus;
+}
+
+/**
+ * Restricts the thread to the given CPUs.
+ */
+inline bool setAffinity(pthread_t thread, const cpu_set_t &cpus) noexcept {
+    return 0 == pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+}
+
+/**
+ * Locks all current and future mappings of the process into RAM, which also
+ * faults in all pages that are currently mapped.
+ */
+inline bool lockMemory() noexcept {
+    return 0 == mlockall(MCL_CURRENT | MCL_FUTURE);
+}
+
+/**
+ * Locks the given memory into RAM, which also faults it in.
+ */
+inline bool lock(char *data, std::size_t size) noexcept {
+    return 0 == mlock(data, size);
+}
+
+/**
+ * Touches every page of the given memory to fault it in before it is used;
+ * the contents are kept.
+ */
+inline void prefault(char *data, std::size_t size) noexcept {
+    const std::size_t PAGE_SIZE{static_cast<std::size_t>(sysconf(_SC_PAGESIZE))};
+    volatile char *p{data};
+    for (std::size_t i{0}; i < size; i += PAGE_SIZE) {
+        p[i] = p[i];
+    }
+}
+
+/**
+ * Private page-aligned memory that is faulted in on construction and locked
+ * into RAM if the limits allow it; used for Pylon's grab buffers.
+ */
+class LockedMemory {
+   private:
+    LockedMemory(const LockedMemory &) = delete;
+    LockedMemory(LockedMemory &&)      = delete;
+    LockedMemory &operator=(const LockedMemory &) = delete;
+    LockedMemory &operator=(LockedMemory &&) = delete;
+
+   public:
+    explicit LockedMemory(std::size_t size) noexcept
+        : m_size{size} {
+        void *memory{mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0)};
+        if (MAP_FAILED != memory) {
+            m_data = static_cast<char*>(memory);
+            m_locked = lock(m_data, m_size);
+        }
+    }
+    ~LockedMemory() {
+        if (nullptr != m_data) {
+            munmap(m_data, m_size);
+        }
+    }
+
+    bool valid() const noexcept {
+        return nullptr != m_data;
+    }
+    bool locked() const noexcept {
+        return m_locked;
+    }
+    char *data() noexcept {
+        return m_data;
+    }
+    std::size_t size() const noexcept {
+        return m_size;
+    }
+
+   private:
+    char *m_data{nullptr};
+    std::size_t m_size{0};
+    bool m_locked{false};
+};
+
+/**
+ * Parses a comma-separated list of CPUs like "2,3".
+ */
+inline std::vector<int32_t> parseCPUs(const std::string &list) {
+    std::vector<int32_t> cpus;
+    std::stringstream sstr{list};
+    std::string cpu;
+    while (std::getline(sstr, cpu, ',')) {
+        if (!cpu.empty()) {
+            cpus.push_back(std::stoi(cpu));
+        }
+    }
+    return cpus;
+}
+
+/**
+ * Measures the scheduling latency of the calling thread as cyclictest does:
+ * the thread sleeps until absolute deadlines every period and records how
+ * late it woke up until stop is set.
+ *
+ * @param stop Flag to end the measurement.
+ * @param histogram Receives the wake-up latencies in microseconds.
+ * @param periodInMicroseconds Time between two wake-ups.
+ */
+inline void measureSchedulingLatency(const std::atomic<bool> &stop, LatencyHistogram &histogram, uint32_t periodInMicroseconds) noexcept {
+    timespec next{};
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!stop.load(std::memory_order_relaxed)) {
+        next.tv_nsec += static_cast<long>(periodInMicroseconds) * 1000;
+        while (1000000000L <= next.tv_nsec) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+        timespec now{};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        histogram.record((static_cast<int64_t>(now.tv_sec - next.tv_sec) * 1000000000L + (now.tv_nsec - next.tv_nsec)) / 1000);
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REC_FILE_HPP
+#define REC_FILE_HPP
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+/**
+ * .rec file of cluon Envelopes holding opendlv.proxy.ImageReading (id 1055)
+ * messages, written by a single thread.
+ *
+ * The Envelope is encoded around the pixels directly into a page-aligned
+ * staging buffer that is written in large blocks, bypassing the page cache
+ * (O_DIRECT) if the file system supports it. The encoding is the one of
+ * cluon::serializeEnvelope so that the files can be replayed with cluon's
+ * tools; as its header stores the length in 24 bits, an Envelope is limited
+ * to 16 MB.
+ */
+class RecFile {
+   private:
+    RecFile(const RecFile &) = delete;
+    RecFile(RecFile &&)      = delete;
+    RecFile &operator=(const RecFile &) = delete;
+    RecFile &operator=(RecFile &&) = delete;
+
+   public:
+    static constexpr int32_t IMAGE_READING{1055};
+    static constexpr uint32_t MAX_ENVELOPE_SIZE{(1u << 24) - 1};
+    static constexpr std::size_t ALIGNMENT{4096};
+    static constexpr std::size_t BLOCK_SIZE{8 * 1024 * 1024};
+
+   private:
+    struct AlignedDeleter {
+        void operator()(char *p) const noexcept {
+            std::free(p);
+        }
+    };
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param filename .rec file to create (an existing file is replaced).
+     */
+    explicit RecFile(const std::string &filename) noexcept {
+        void *staging{nullptr};
+        if (0 != posix_memalign(&staging, ALIGNMENT, BLOCK_SIZE)) {
+            return;
+        }
+        m_staging.reset(static_cast<char*>(staging));
+
+        m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        m_direct = (0 <= m_fd);
+        if (!m_direct) {
+            // File systems like tmpfs do not support O_DIRECT.
+            m_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+    }
+
+    ~RecFile() {
+        if (0 <= m_fd) {
+            flush();
+            ::close(m_fd);
+        }
+    }
+
+    bool valid() const noexcept {
+        return 0 <= m_fd;
+    }
+
+    /**
+     * @return Size of the Envelope holding an ImageReading with the given
+     *         properties (at most MAX_ENVELOPE_SIZE to fit into a .rec file).
+     */
+    static uint64_t envelopeSize(const std::string &fourcc, uint32_t width, uint32_t height, uint32_t size, uint32_t senderStamp, int64_t sampleTimeStampInMicroseconds, int64_t sentInMicroseconds) noexcept {
+        const uint64_t IMAGE_READING_SIZE{imageReadingSize(fourcc, width, height, size)};
+        return 1 + varIntSize(zigZag(IMAGE_READING))
+             + 1 + varIntSize(IMAGE_READING_SIZE) + IMAGE_READING_SIZE
+             + 2 * (1 + 1 + static_cast<uint64_t>(timeStampSize(sentInMicroseconds)))
+             + 1 + 1 + timeStampSize(sampleTimeStampInMicroseconds)
+             + 1 + varIntSize(senderStamp);
+    }
+
+    /**
+     * Appends an Envelope holding an ImageReading; sent and received are
+     * set to sentInMicroseconds.
+     *
+     * @return false if the Envelope would exceed MAX_ENVELOPE_SIZE.
+     */
+    bool write(const std::string &fourcc, uint32_t width, uint32_t height, const char *data, uint32_t size, uint32_t senderStamp, int64_t sampleTimeStampInMicroseconds, int64_t sentInMicroseconds) noexcept {
+        const uint64_t ENVELOPE_SIZE{envelopeSize(fourcc, width, height, size, senderStamp, sampleTimeStampInMicroseconds, sentInMicroseconds)};
+        if ( (MAX_ENVELOPE_SIZE < ENVELOPE_SIZE) || (64 < fourcc.size()) ) {
+            return false;
+        }
+        char header[128];
+
+        // OD4 header: 0x0D, 0xA4, and the size of the Envelope in 24 bits.
+        char *out{header};
+        *out++ = static_cast<char>(0x0D);
+        *out++ = static_cast<char>(0xA4);
+        *out++ = static_cast<char>(ENVELOPE_SIZE & 0xFF);
+        *out++ = static_cast<char>((ENVELOPE_SIZE >> 8) & 0xFF);
+        *out++ = static_cast<char>((ENVELOPE_SIZE >> 16) & 0xFF);
+
+        // Envelope up to the pixels: dataType, serializedData holding the ImageReading.
+        out = varInt(out, (1 << 3) | 0);
+        out = varInt(out, zigZag(IMAGE_READING));
+        out = varInt(out, (2 << 3) | 2);
+        out = varInt(out, imageReadingSize(fourcc, width, height, size));
+        out = varInt(out, (1 << 3) | 2);
+        out = varInt(out, fourcc.size());
+        out = std::copy(fourcc.begin(), fourcc.end(), out);
+        out = varInt(out, (2 << 3) | 0);
+        out = varInt(out, width);
+        out = varInt(out, (3 << 3) | 0);
+        out = varInt(out, height);
+        out = varInt(out, (4 << 3) | 2);
+        out = varInt(out, size);
+        append(header, static_cast<std::size_t>(out - header));
+
+        append(data, size);
+
+        // Envelope after the pixels: sent, received, sampleTimeStamp, and senderStamp.
+        out = header;
+        out = timeStamp(out, 3, sentInMicroseconds);
+        out = timeStamp(out, 4, sentInMicroseconds);
+        out = timeStamp(out, 5, sampleTimeStampInMicroseconds);
+        out = varInt(out, (6 << 3) | 0);
+        out = varInt(out, senderStamp);
+        append(header, static_cast<std::size_t>(out - header));
+        return true;
+    }
+
+    /**
+     * @return Bytes written to the disk so far.
+     */
+    uint64_t bytes() const noexcept {
+        return m_bytes.load(std::memory_order_relaxed);
+    }
+
+    uint64_t failedWrites() const noexcept {
+        return m_failedWrites.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @return Bytes per second while writing to the disk.
+     */
+    double throughput() const noexcept {
+        const uint64_t MICROSECONDS{m_writeTimeInMicroseconds.load(std::memory_order_relaxed)};
+        return (0 == MICROSECONDS) ? 0.0 : static_cast<double>(bytes()) * 1000.0 * 1000.0 / static_cast<double>(MICROSECONDS);
+    }
+
+    /**
+     * @return true while the file is written without the page cache.
+     */
+    bool direct() const noexcept {
+        return m_direct.load(std::memory_order_relaxed);
+    }
+
+   private:
+    static uint32_t zigZag(int32_t v) noexcept {
+        return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+    }
+
+    static uint32_t varIntSize(uint64_t v) noexcept {
+        uint32_t size{1};
+        for (; 0x7f < v; v >>= 7) {
+            size++;
+        }
+        return size;
+    }
+
+    static char *varInt(char *out, uint64_t v) noexcept {
+        for (; 0x7f < v; v >>= 7) {
+            *out++ = static_cast<char>((v & 0x7f) | 0x80);
+        }
+        *out++ = static_cast<char>(v);
+        return out;
+    }
+
+    static uint32_t timeStampSize(int64_t microseconds) noexcept {
+        return 1 + varIntSize(zigZag(static_cast<int32_t>(microseconds / 1000000))) + 1 + varIntSize(zigZag(static_cast<int32_t>(microseconds % 1000000)));
+    }
+
+    static char *timeStamp(char *out, uint32_t id, int64_t microseconds) noexcept {
+        out = varInt(out, (id << 3) | 2);
+        out = varInt(out, timeStampSize(microseconds));
+        out = varInt(out, (1 << 3) | 0);
+        out = varInt(out, zigZag(static_cast<int32_t>(microseconds / 1000000)));
+        out = varInt(out, (2 << 3) | 0);
+        return varInt(out, zigZag(static_cast<int32_t>(microseconds % 1000000)));
+    }
+
+    static uint64_t imageReadingSize(const std::string &fourcc, uint32_t width, uint32_t height, uint32_t size) noexcept {
+        return 1 + varIntSize(fourcc.size()) + static_cast<uint64_t>(fourcc.size())
+             + 1 + varIntSize(width) + 1 + varIntSize(height)
+             + 1 + varIntSize(size) + static_cast<uint64_t>(size);
+    }
+
+    // Appends to the staging buffer and writes every complete block.
+    void append(const char *data, std::size_t size) noexcept {
+        while (0 < size) {
+            const std::size_t LENGTH{std::min(size, BLOCK_SIZE - m_staged)};
+            std::memcpy(m_staging.get() + m_staged, data, LENGTH);
+            m_staged += LENGTH;
+            data += LENGTH;
+            size -= LENGTH;
+            if (BLOCK_SIZE == m_staged) {
+                flush();
+            }
+        }
+    }
+
+    void flush() noexcept {
+        if (0 == m_staged) {
+            return;
+        }
+        if ( m_direct && (0 != (m_staged % ALIGNMENT)) ) {
+            // Only the last block may be partial; O_DIRECT needs aligned sizes.
+            ::fcntl(m_fd, F_SETFL, ::fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+            m_direct = false;
+        }
+        const auto start{std::chrono::steady_clock::now()};
+        std::size_t written{0};
+        while (written < m_staged) {
+            const ssize_t RETVAL{::write(m_fd, m_staging.get() + written, m_staged - written)};
+            if (0 > RETVAL) {
+                if (EINTR == errno) {
+                    continue;
+                }
+                m_failedWrites.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            written += static_cast<std::size_t>(RETVAL);
+        }
+        m_writeTimeInMicroseconds.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()), std::memory_order_relaxed);
+        m_bytes.fetch_add(written, std::memory_order_relaxed);
+        m_staged = 0;
+    }
+
+   private:
+    int m_fd{-1};
+    std::atomic<bool> m_direct{false};
+    std::unique_ptr<char, AlignedDeleter> m_staging{nullptr};
+    std::size_t m_staged{0};
+
+    std::atomic<uint64_t> m_bytes{0};
+    std::atomic<uint64_t> m_failedWrites{0};
+    std::atomic<uint64_t> m_writeTimeInMicroseconds{0};
+};
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARED_MEMORY_BUFFER_FACTORY_HPP
+#define SHARED_MEMORY_BUFFER_FACTORY_HPP
+
+#include <pylon/PylonIncludes.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/**
+ * Pylon buffer factory handing out the slots of a shared memory area so that
+ * the stream grabber places the received frames directly in shared memory.
+ * The index of the slot is passed as buffer context and can be retrieved
+ * from a grab result via GetBufferContext(). The slots can also be placed in
+ * any other memory owned by the caller, e.g., memory locked into RAM.
+ */
+class SharedMemoryBufferFactory : public Pylon::IBufferFactory {
+   private:
+    SharedMemoryBufferFactory(const SharedMemoryBufferFactory &) = delete;
+    SharedMemoryBufferFactory(SharedMemoryBufferFactory &&)      = delete;
+    SharedMemoryBufferFactory &operator=(const SharedMemoryBufferFactory &) = delete;
+    SharedMemoryBufferFactory &operator=(SharedMemoryBufferFactory &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param slots Pointer to the first slot.
+     * @param slotCount Number of slots.
+     * @param slotSize Size in bytes of each slot.
+     */
+    SharedMemoryBufferFactory(char *slots, uint32_t slotCount, uint32_t slotSize) noexcept
+        : m_slots{slots}
+        , m_slotSize{slotSize}
+        , m_inUse(slotCount, false) {}
+    ~SharedMemoryBufferFactory() override = default;
+
+    void AllocateBuffer(size_t bufferSize, void **pCreatedBuffer, intptr_t &bufferContext) override {
+        std::lock_guard<std::mutex> lck(m_inUseMutex);
+        if (bufferSize <= m_slotSize) {
+            for (std::size_t i{0}; i < m_inUse.size(); i++) {
+                if (!m_inUse[i]) {
+                    m_inUse[i] = true;
+                    *pCreatedBuffer = m_slots + i * m_slotSize;
+                    bufferContext = static_cast<intptr_t>(i);
+                    return;
+                }
+            }
+        }
+        throw std::bad_alloc();
+    }
+
+    void FreeBuffer(void *, intptr_t bufferContext) override {
+        std::lock_guard<std::mutex> lck(m_inUseMutex);
+        if ( (0 <= bufferContext) && (static_cast<std::size_t>(bufferContext) < m_inUse.size()) ) {
+            m_inUse[static_cast<std::size_t>(bufferContext)] = false;
+        }
+    }
+
+    void DestroyBufferFactory() override {
+        // The lifetime of this factory is managed by the caller (Cleanup_None).
+    }
+
+   private:
+    char *m_slots{nullptr};
+    uint32_t m_slotSize{0};
+    std::mutex m_inUseMutex{};
+    std::vector<bool> m_inUse{};
+};
+
+#endif
@@ -0,0 +1,487 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARED_MEMORY_LAYOUT_HPP
+#define SHARED_MEMORY_LAYOUT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+/**
+ * Registration of the readers of a shared memory area.
+ *
+ * A reader claims an entry with attach() and refreshes its heartbeat with
+ * heartbeat() at least every few hundred milliseconds while it is interested
+ * in frames; detach() releases the entry. Entries of readers that stopped
+ * sending heartbeats (e.g., because they crashed) are considered stale after
+ * a timeout and may be claimed by other readers. The producer uses
+ * hasLiveReader() to skip producing frames nobody is waiting for.
+ */
+struct ReaderRegistry {
+    static constexpr uint32_t MAX_READERS{16};
+
+    struct Entry {
+        std::atomic<int32_t> pid{0};
+        uint32_t reserved{0};
+        std::atomic<int64_t> heartbeatInMicroseconds{0};
+    };
+
+    Entry readers[MAX_READERS]{};
+
+    /**
+     * Registers a reader.
+     *
+     * @param pid Process ID of the reader.
+     * @param now Current time in microseconds.
+     * @param timeout Time in microseconds after which an entry without heartbeat is stale.
+     * @return Index of the claimed entry or -1 if all entries are taken.
+     */
+    int32_t attach(int32_t pid, int64_t now, int64_t timeout) noexcept {
+        for (uint32_t i{0}; i < MAX_READERS; i++) {
+            int32_t previous{readers[i].pid.load(std::memory_order_acquire)};
+            const bool isStale{(0 != previous) && (now - readers[i].heartbeatInMicroseconds.load(std::memory_order_relaxed) > timeout)};
+            if ( ((0 == previous) || isStale) &&
+                 readers[i].pid.compare_exchange_strong(previous, pid, std::memory_order_acq_rel) ) {
+                readers[i].heartbeatInMicroseconds.store(now, std::memory_order_release);
+                return static_cast<int32_t>(i);
+            }
+        }
+        return -1;
+    }
+
+    void heartbeat(int32_t entry, int64_t now) noexcept {
+        readers[entry].heartbeatInMicroseconds.store(now, std::memory_order_release);
+    }
+
+    void detach(int32_t entry) noexcept {
+        readers[entry].heartbeatInMicroseconds.store(0, std::memory_order_relaxed);
+        readers[entry].pid.store(0, std::memory_order_release);
+    }
+
+    /**
+     * @param now Current time in microseconds.
+     * @param timeout Time in microseconds after which an entry without heartbeat is stale.
+     * @return true if at least one reader sent a heartbeat within timeout.
+     */
+    bool hasLiveReader(int64_t now, int64_t timeout) const noexcept {
+        for (uint32_t i{0}; i < MAX_READERS; i++) {
+            if ( (0 != readers[i].pid.load(std::memory_order_acquire)) &&
+                 (now - readers[i].heartbeatInMicroseconds.load(std::memory_order_acquire) <= timeout) ) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * Counters of the frames that the camera captured but that were not
+ * published, updated by the producer after every grab result:
+ * - lostFrames: gaps in the camera's block IDs, i.e., frames that never
+ *   reached the host (e.g., dropped by the network or the camera's buffers),
+ * - skippedImages: frames skipped by the grab strategy on the host,
+ * - incompleteFrames: frames that arrived with missing packets,
+ * - failedGrabs: all grab results that did not succeed (including incomplete ones),
+ * - droppedFrames: grabbed frames dropped from the queue in pipeline mode.
+ * A reader correlates them with frameCounter to find where frames were lost.
+ */
+struct FrameLossCounters {
+    std::atomic<uint64_t> lostFrames{0};
+    std::atomic<uint64_t> skippedImages{0};
+    std::atomic<uint64_t> incompleteFrames{0};
+    std::atomic<uint64_t> failedGrabs{0};
+    std::atomic<uint64_t> droppedFrames{0};
+};
+
+/**
+ * Layout of a shared memory area holding a single frame.
+ *
+ * The area starts with this header and the frame itself starts at
+ * dataOffset. The time stamps and the frame counter are written together
+ * with the frame while holding the shared memory's lock; a reader holding
+ * the lock hence sees the meta data belonging to the frame.
+ */
+struct FrameAreaHeader {
+    static constexpr uint32_t MAGIC{0x454d5246}; // 'FRME'
+    static constexpr uint32_t PAGE_SIZE{4096};
+
+    uint32_t magic{MAGIC};
+    uint32_t headerSize{sizeof(FrameAreaHeader)};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t frameSize{0};
+    uint32_t dataOffset{PAGE_SIZE};
+    std::atomic<uint64_t> frameCounter{0};
+    std::atomic<int64_t> sampleTimeStampInMicroseconds{0};
+    std::atomic<int64_t> hostTimeStampInMicroseconds{0};
+    ReaderRegistry registry{};
+    FrameLossCounters loss{};
+
+    /**
+     * @return Size of the shared memory area for a frame of frameSize bytes.
+     */
+    static uint32_t sizeOfArea(uint32_t frameSize) noexcept {
+        return PAGE_SIZE + frameSize;
+    }
+
+    /**
+     * Initializes the layout in the given shared memory area.
+     */
+    static FrameAreaHeader *create(char *area, uint32_t width, uint32_t height, uint32_t frameSize) noexcept {
+        FrameAreaHeader *header = new (area) FrameAreaHeader();
+        header->width = width;
+        header->height = height;
+        header->frameSize = frameSize;
+        return header;
+    }
+
+    char *frameData() noexcept {
+        return reinterpret_cast<char*>(this) + dataOffset;
+    }
+
+    /**
+     * Stores the meta data of the frame being written; to be called while
+     * holding the shared memory's lock.
+     */
+    void setFrame(uint64_t frame, int64_t sampleTimeStamp, int64_t hostTimeStamp) noexcept {
+        frameCounter.store(frame, std::memory_order_relaxed);
+        sampleTimeStampInMicroseconds.store(sampleTimeStamp, std::memory_order_relaxed);
+        hostTimeStampInMicroseconds.store(hostTimeStamp, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * Header of one slot in a FrameRingHeader-based shared memory area.
+ *
+ * sequence is odd while the producer is writing frame n into the slot
+ * (2n-1) and even once the frame is complete (2n); 0 marks a slot that was
+ * never written. A reader copying or consuming a slot compares sequence
+ * before and after the access to detect a concurrent overwrite.
+ */
+struct FrameSlotHeader {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<int64_t> sampleTimeStampInMicroseconds{0};
+    std::atomic<int64_t> hostTimeStampInMicroseconds{0};
+    char padding[40]{};
+};
+
+/**
+ * Layout of the shared memory area holding the raw YUYV frames as received
+ * from the camera. The area starts with this header followed by slotCount
+ * FrameSlotHeaders at slotHeaderOffset and slotCount slots of slotSize bytes
+ * each at offset slotOffset; every slot is a Pylon grab buffer. latestSlot
+ * is updated while holding the shared memory's lock.
+ *
+ * A frame is published as soon as it arrived from the camera and its slot
+ * stays valid until the next frame is published, i.e., for one frame
+ * period. Then, the sequence of the slot, which is 2n while it holds the
+ * published frame n, becomes odd and the grab buffer is returned (requeued)
+ * to Pylon (in --pipeline mode, once the frame was converted as well),
+ * which refills it without any notification. A reader compares sequence
+ * before and after copying a slot as for FrameRingHeader to detect a refill.
+ */
+struct RawFrameAreaHeader {
+    static constexpr uint32_t MAGIC{0x56595559}; // 'YUYV'
+    static constexpr uint32_t PAGE_SIZE{4096};
+
+    uint32_t magic{MAGIC};
+    uint32_t headerSize{sizeof(RawFrameAreaHeader)};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t stride{0};
+    uint32_t slotCount{0};
+    uint32_t slotSize{0};
+    uint32_t slotOffset{0};
+    std::atomic<int32_t> latestSlot{-1};
+    uint32_t slotHeaderOffset{0};
+    std::atomic<uint64_t> frameCounter{0};
+    std::atomic<int64_t> sampleTimeStampInMicroseconds{0};
+    std::atomic<int64_t> hostTimeStampInMicroseconds{0};
+
+    static uint32_t offsetOfSlotHeaders() noexcept {
+        return (static_cast<uint32_t>(sizeof(RawFrameAreaHeader)) + 63) / 64 * 64;
+    }
+
+    static uint32_t offsetOfSlots(uint32_t slotCount) noexcept {
+        return (offsetOfSlotHeaders() + slotCount * static_cast<uint32_t>(sizeof(FrameSlotHeader)) + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    }
+
+    /**
+     * Initializes the layout in the given shared memory area.
+     */
+    static RawFrameAreaHeader *create(char *area, uint32_t width, uint32_t height, uint32_t stride, uint32_t slotCount, uint32_t slotSize) noexcept {
+        RawFrameAreaHeader *header = new (area) RawFrameAreaHeader();
+        header->width = width;
+        header->height = height;
+        header->stride = stride;
+        header->slotCount = slotCount;
+        header->slotSize = slotSize;
+        header->slotOffset = offsetOfSlots(slotCount);
+        header->slotHeaderOffset = offsetOfSlotHeaders();
+        for (uint32_t i{0}; i < slotCount; i++) {
+            new (area + offsetOfSlotHeaders() + i * sizeof(FrameSlotHeader)) FrameSlotHeader();
+        }
+        return header;
+    }
+
+    FrameSlotHeader &slotHeader(uint32_t slot) noexcept {
+        return *reinterpret_cast<FrameSlotHeader*>(reinterpret_cast<char*>(this) + slotHeaderOffset + slot * sizeof(FrameSlotHeader));
+    }
+
+    /**
+     * Publishes the frame in slot as the latest frame; to be called while
+     * holding the shared memory's lock.
+     */
+    void publish(uint32_t slot, int64_t sampleTimeStamp, int64_t hostTimeStamp) noexcept {
+        const uint64_t FRAME{frameCounter.load(std::memory_order_relaxed) + 1};
+        FrameSlotHeader &h{slotHeader(slot)};
+        h.sampleTimeStampInMicroseconds.store(sampleTimeStamp, std::memory_order_relaxed);
+        h.hostTimeStampInMicroseconds.store(hostTimeStamp, std::memory_order_relaxed);
+        h.sequence.store(2 * FRAME, std::memory_order_release);
+        sampleTimeStampInMicroseconds.store(sampleTimeStamp);
+        hostTimeStampInMicroseconds.store(hostTimeStamp);
+        latestSlot.store(static_cast<int32_t>(slot));
+        frameCounter.store(FRAME);
+    }
+
+    /**
+     * Marks slot as being refilled; to be called while holding the shared
+     * memory's lock before its grab buffer is returned to Pylon.
+     */
+    void requeue(uint32_t slot) noexcept {
+        FrameSlotHeader &h{slotHeader(slot)};
+        h.sequence.store(h.sequence.load(std::memory_order_relaxed) | 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+};
+
+/**
+ * Layout of a shared memory area holding the last slotCount frames.
+ *
+ * The area starts with this header followed by slotCount FrameSlotHeaders;
+ * the frames themselves start at slotOffset and are slotSize bytes apart.
+ * Frame n (starting at 1) is written into slot (n-1) % slotCount and
+ * writeIndex holds the number of the latest complete frame. The producer
+ * never takes the shared memory's lock for this layout; readers detect
+ * skipped frames by gaps in the frame numbers.
+ */
+struct FrameRingHeader {
+    static constexpr uint32_t MAGIC{0x474e4952}; // 'RING'
+    static constexpr uint32_t PAGE_SIZE{4096};
+
+    uint32_t magic{MAGIC};
+    uint32_t headerSize{sizeof(FrameRingHeader)};
+    uint32_t width{0};
+    uint32_t height{0};
+    uint32_t frameSize{0};
+    uint32_t slotCount{0};
+    uint32_t slotSize{0};
+    uint32_t slotOffset{0};
+    std::atomic<uint64_t> writeIndex{0};
+    ReaderRegistry registry{};
+    FrameLossCounters loss{};
+
+    static uint32_t offsetOfSlotHeaders() noexcept {
+        return (static_cast<uint32_t>(sizeof(FrameRingHeader)) + 63) / 64 * 64;
+    }
+
+    static uint32_t offsetOfSlots(uint32_t slotCount) noexcept {
+        return (offsetOfSlotHeaders() + slotCount * static_cast<uint32_t>(sizeof(FrameSlotHeader)) + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    }
+
+    static uint32_t sizeOfSlot(uint32_t frameSize) noexcept {
+        return (frameSize + 63) / 64 * 64;
+    }
+
+    /**
+     * @return Size of the shared memory area for slotCount frames of frameSize bytes.
+     */
+    static uint32_t sizeOfArea(uint32_t slotCount, uint32_t frameSize) noexcept {
+        return offsetOfSlots(slotCount) + slotCount * sizeOfSlot(frameSize);
+    }
+
+    /**
+     * Initializes the layout in the given shared memory area.
+     */
+    static FrameRingHeader *create(char *area, uint32_t width, uint32_t height, uint32_t slotCount, uint32_t frameSize) noexcept {
+        FrameRingHeader *header = new (area) FrameRingHeader();
+        header->width = width;
+        header->height = height;
+        header->frameSize = frameSize;
+        header->slotCount = slotCount;
+        header->slotSize = sizeOfSlot(frameSize);
+        header->slotOffset = offsetOfSlots(slotCount);
+        for (uint32_t i{0}; i < slotCount; i++) {
+            new (area + offsetOfSlotHeaders() + i * sizeof(FrameSlotHeader)) FrameSlotHeader();
+        }
+        return header;
+    }
+
+    FrameSlotHeader &slotHeader(uint32_t slot) noexcept {
+        return *reinterpret_cast<FrameSlotHeader*>(reinterpret_cast<char*>(this) + offsetOfSlotHeaders() + slot * sizeof(FrameSlotHeader));
+    }
+
+    char *slotData(uint32_t slot) noexcept {
+        return reinterpret_cast<char*>(this) + slotOffset + slot * slotSize;
+    }
+
+    /**
+     * Marks the slot for frame as being written.
+     *
+     * @param frame Number of the frame to write (starting at 1).
+     * @param sampleTimeStamp Sample time stamp of the frame.
+     * @param hostTimeStamp Time stamp when the frame was received on the host.
+     * @return Pointer to the slot to write the frame to.
+     */
+    char *beginWrite(uint64_t frame, int64_t sampleTimeStamp, int64_t hostTimeStamp) noexcept {
+        const uint32_t slot{static_cast<uint32_t>((frame - 1) % slotCount)};
+        FrameSlotHeader &h{slotHeader(slot)};
+        h.sequence.store(2 * frame - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        h.sampleTimeStampInMicroseconds.store(sampleTimeStamp, std::memory_order_relaxed);
+        h.hostTimeStampInMicroseconds.store(hostTimeStamp, std::memory_order_relaxed);
+        return slotData(slot);
+    }
+
+    /**
+     * Marks frame as complete and makes it the latest frame.
+     */
+    void endWrite(uint64_t frame) noexcept {
+        const uint32_t slot{static_cast<uint32_t>((frame - 1) % slotCount)};
+        slotHeader(slot).sequence.store(2 * frame, std::memory_order_release);
+        writeIndex.store(frame, std::memory_order_release);
+    }
+};
+
+/**
+ * Header of one set slot in a FrameSetHeader-based shared memory area.
+ *
+ * sequence is odd while the frames of set n are written into the slot
+ * (2n-1) and even once all frames of the set are complete (2n); a reader
+ * compares sequence before and after the access as for FrameSlotHeader.
+ */
+struct FrameSetSlotHeader {
+    static constexpr uint32_t MAX_CAMERAS{16};
+
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<int64_t> sampleTimeStampInMicroseconds[MAX_CAMERAS]{};
+};
+
+/**
+ * Layout of a shared memory area holding sets of I420 frames, one per
+ * camera, whose time stamps are within toleranceInMicroseconds.
+ *
+ * The area starts with this header followed by slotCount
+ * FrameSetSlotHeaders; the set slots start at slotOffset and are slotSize
+ * bytes apart. Within a set slot, the frame of camera i starts at
+ * cameras[i].offset. setId is the ID of the latest complete set and
+ * latestSlot its slot; set IDs of sets that were not completed are skipped.
+ * The producer never takes the shared memory's lock for this layout.
+ */
+struct FrameSetHeader {
+    static constexpr uint32_t MAGIC{0x54455346}; // 'FSET'
+    static constexpr uint32_t PAGE_SIZE{4096};
+    static constexpr uint32_t MAX_CAMERAS{FrameSetSlotHeader::MAX_CAMERAS};
+
+    struct Camera {
+        uint32_t width{0};
+        uint32_t height{0};
+        uint32_t frameSize{0};
+        uint32_t offset{0};
+    };
+
+    uint32_t magic{MAGIC};
+    uint32_t headerSize{sizeof(FrameSetHeader)};
+    uint32_t cameraCount{0};
+    uint32_t slotCount{0};
+    uint32_t slotSize{0};
+    uint32_t slotOffset{0};
+    int64_t toleranceInMicroseconds{0};
+    Camera cameras[MAX_CAMERAS]{};
+    std::atomic<uint64_t> setId{0};
+    std::atomic<int32_t> latestSlot{-1};
+    uint32_t reserved{0};
+    std::atomic<uint64_t> completeSets{0};
+    std::atomic<uint64_t> incompleteSets{0};
+    std::atomic<uint64_t> lateFrames{0};
+    std::atomic<uint64_t> droppedFrames{0};
+
+    static uint32_t offsetOfSlotHeaders() noexcept {
+        return (static_cast<uint32_t>(sizeof(FrameSetHeader)) + 63) / 64 * 64;
+    }
+
+    static uint32_t sizeOfSlotHeader() noexcept {
+        return (static_cast<uint32_t>(sizeof(FrameSetSlotHeader)) + 63) / 64 * 64;
+    }
+
+    static uint32_t offsetOfSlots(uint32_t slotCount) noexcept {
+        return (offsetOfSlotHeaders() + slotCount * sizeOfSlotHeader() + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    }
+
+    /**
+     * @return Size of a set slot holding frames of the given sizes.
+     */
+    static uint32_t sizeOfSlot(const uint32_t *frameSizes, uint32_t cameraCount) noexcept {
+        uint32_t size{0};
+        for (uint32_t i{0}; i < cameraCount; i++) {
+            size += (frameSizes[i] + 63) / 64 * 64;
+        }
+        return size;
+    }
+
+    /**
+     * @return Size of the shared memory area for slotCount sets of frames of the given sizes.
+     */
+    static uint32_t sizeOfArea(uint32_t slotCount, const uint32_t *frameSizes, uint32_t cameraCount) noexcept {
+        return offsetOfSlots(slotCount) + slotCount * sizeOfSlot(frameSizes, cameraCount);
+    }
+
+    /**
+     * Initializes the layout in the given shared memory area.
+     */
+    static FrameSetHeader *create(char *area, uint32_t cameraCount, const uint32_t *widths, const uint32_t *heights, const uint32_t *frameSizes, uint32_t slotCount, int64_t tolerance) noexcept {
+        FrameSetHeader *header = new (area) FrameSetHeader();
+        header->cameraCount = cameraCount;
+        header->slotCount = slotCount;
+        header->slotSize = sizeOfSlot(frameSizes, cameraCount);
+        header->slotOffset = offsetOfSlots(slotCount);
+        header->toleranceInMicroseconds = tolerance;
+        uint32_t offset{0};
+        for (uint32_t i{0}; i < cameraCount; i++) {
+            header->cameras[i].width = widths[i];
+            header->cameras[i].height = heights[i];
+            header->cameras[i].frameSize = frameSizes[i];
+            header->cameras[i].offset = offset;
+            offset += (frameSizes[i] + 63) / 64 * 64;
+        }
+        for (uint32_t i{0}; i < slotCount; i++) {
+            new (area + offsetOfSlotHeaders() + i * sizeOfSlotHeader()) FrameSetSlotHeader();
+        }
+        return header;
+    }
+
+    FrameSetSlotHeader &slotHeader(uint32_t slot) noexcept {
+        return *reinterpret_cast<FrameSetSlotHeader*>(reinterpret_cast<char*>(this) + offsetOfSlotHeaders() + slot * sizeOfSlotHeader());
+    }
+
+    char *frameData(uint32_t slot, uint32_t camera) noexcept {
+        return reinterpret_cast<char*>(this) + slotOffset + slot * slotSize + cameras[camera].offset;
+    }
+};
+
+#endif
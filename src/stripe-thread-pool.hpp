@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STRIPE_THREAD_POOL_HPP
+#define STRIPE_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Persistent pool of threads to process a frame in horizontal stripes.
+ *
+ * run() hands the same job to all threads, each one being called with its
+ * own stripe index; the calling thread processes stripe 0 itself and returns
+ * once all stripes are done.
+ */
+class StripeThreadPool {
+   private:
+    StripeThreadPool(const StripeThreadPool &) = delete;
+    StripeThreadPool(StripeThreadPool &&)      = delete;
+    StripeThreadPool &operator=(const StripeThreadPool &) = delete;
+    StripeThreadPool &operator=(StripeThreadPool &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param stripes Number of stripes to process in parallel (including the calling thread).
+     */
+    explicit StripeThreadPool(uint32_t stripes) noexcept
+        : m_stripes{(0 < stripes) ? stripes : 1} {
+        for (uint32_t i{1}; i < m_stripes; i++) {
+            m_threads.emplace_back(std::thread(&StripeThreadPool::worker, this, i));
+        }
+    }
+
+    ~StripeThreadPool() noexcept {
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_stop = true;
+        }
+        m_jobAvailable.notify_all();
+        for (auto &t : m_threads) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+    }
+
+    uint32_t stripes() const noexcept {
+        return m_stripes;
+    }
+
+    /**
+     * @return Native handles of the threads processing the stripes 1 and above.
+     */
+    std::vector<std::thread::native_handle_type> nativeHandles() noexcept {
+        std::vector<std::thread::native_handle_type> handles;
+        for (auto &t : m_threads) {
+            handles.push_back(t.native_handle());
+        }
+        return handles;
+    }
+
+    /**
+     * Processes the given job for all stripes and waits for its completion.
+     *
+     * @param job to be called with (stripe index, number of stripes).
+     */
+    void run(const std::function<void(uint32_t, uint32_t)> &job) noexcept {
+        if (1 == m_stripes) {
+            job(0, 1);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lck(m_mutex);
+            m_job = &job;
+            m_pending = m_stripes - 1;
+            m_generation++;
+        }
+        m_jobAvailable.notify_all();
+
+        job(0, m_stripes);
+
+        std::unique_lock<std::mutex> lck(m_mutex);
+        m_jobDone.wait(lck, [this](){ return 0 == m_pending; });
+        m_job = nullptr;
+    }
+
+    /**
+     * Computes the rows [begin, end) of a stripe; the boundaries are kept at
+     * even rows to respect the vertical chroma subsampling of I420.
+     *
+     * @param stripe Index of the stripe.
+     * @param stripes Number of stripes.
+     * @param height Height of the frame.
+     * @param begin First row of the stripe.
+     * @param end Row after the last row of the stripe.
+     */
+    static void rowsOfStripe(uint32_t stripe, uint32_t stripes, uint32_t height, uint32_t &begin, uint32_t &end) noexcept {
+        const uint32_t ROW_PAIRS{height / 2};
+        begin = (ROW_PAIRS * stripe / stripes) * 2;
+        end = (stripe + 1 == stripes) ? height : (ROW_PAIRS * (stripe + 1) / stripes) * 2;
+    }
+
+   private:
+    void worker(uint32_t stripe) noexcept {
+        uint64_t lastGeneration{0};
+        for (;;) {
+            const std::function<void(uint32_t, uint32_t)> *job{nullptr};
+            {
+                std::unique_lock<std::mutex> lck(m_mutex);
+                m_jobAvailable.wait(lck, [this, &lastGeneration](){ return m_stop || (lastGeneration != m_generation); });
+                if (m_stop) {
+                    return;
+                }
+                lastGeneration = m_generation;
+                job = m_job;
+            }
+
+            (*job)(stripe, m_stripes);
+
+            bool allDone{false};
+            {
+                std::lock_guard<std::mutex> lck(m_mutex);
+                allDone = (0 == --m_pending);
+            }
+            if (allDone) {
+                m_jobDone.notify_one();
+            }
+        }
+    }
+
+   private:
+    uint32_t m_stripes{1};
+    std::vector<std::thread> m_threads{};
+
+    std::mutex m_mutex{};
+    std::condition_variable m_jobAvailable{};
+    std::condition_variable m_jobDone{};
+    const std::function<void(uint32_t, uint32_t)> *m_job{nullptr};
+    uint32_t m_pending{0};
+    uint64_t m_generation{0};
+    bool m_stop{false};
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef X11_PREVIEW_HPP
+#define X11_PREVIEW_HPP
+
+#include <libyuv.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Window showing the latest ARGB frame at a limited rate from its own thread.
+ *
+ * The producer only stores the address of the latest complete frame; the
+ * preview thread picks it up at the display rate, scales it into an image
+ * shared with the X server via the MIT-SHM extension (or a client-side image
+ * if the X server is remote), and waits for the X server itself. Thus,
+ * neither grabbing nor publishing ever waits for the X server. A frame that
+ * is overwritten while being copied shows up torn in the preview only.
+ */
+class X11Preview {
+   private:
+    X11Preview(const X11Preview &) = delete;
+    X11Preview(X11Preview &&)      = delete;
+    X11Preview &operator=(const X11Preview &) = delete;
+    X11Preview &operator=(X11Preview &&) = delete;
+
+   public:
+    /**
+     * Constructor.
+     *
+     * @param title Title of the window.
+     * @param width Width of the ARGB frames.
+     * @param height Height of the ARGB frames.
+     * @param scale Divisor for the size of the window (1 for full size).
+     * @param fps Maximum rate to update the window.
+     */
+    X11Preview(const std::string &title, uint32_t width, uint32_t height, uint32_t scale, float fps) noexcept
+        : m_title{title}
+        , m_width{width}
+        , m_height{height}
+        , m_previewWidth{std::max<uint32_t>(1, width / std::max<uint32_t>(1, scale))}
+        , m_previewHeight{std::max<uint32_t>(1, height / std::max<uint32_t>(1, scale))}
+        , m_period{std::chrono::microseconds(static_cast<int64_t>(1000.0f * 1000.0f / std::max(0.1f, fps)))} {
+        m_thread = std::thread(&X11Preview::run, this);
+    }
+
+    ~X11Preview() {
+        {
+            std::lock_guard<std::mutex> lck(m_stopMutex);
+            m_stop = true;
+        }
+        m_stopCondition.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    /**
+     * Offers the latest complete ARGB frame (stride: width*4) to the preview;
+     * never blocks.
+     */
+    void offer(const char *argb) noexcept {
+        m_latestFrame.store(argb, std::memory_order_release);
+        m_offeredFrames.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @return Number of frames that were shown.
+     */
+    uint64_t shownFrames() const noexcept {
+        return m_shownFrames.load(std::memory_order_relaxed);
+    }
+
+   private:
+    void run() noexcept {
+        Display *display{XOpenDisplay(nullptr)};
+        if (nullptr == display) {
+            std::cerr << "[opendlv-device-camera-pylon]: Failed to open the X display for the preview." << std::endl;
+            return;
+        }
+        const int SCREEN{DefaultScreen(display)};
+        Visual *visual{DefaultVisual(display, SCREEN)};
+        Window window{XCreateSimpleWindow(display, RootWindow(display, SCREEN), 0, 0, m_previewWidth, m_previewHeight, 1, 0, 0)};
+        XStoreName(display, window, m_title.c_str());
+        XMapWindow(display, window);
+
+        // Prefer an image in shared memory; the X server reads it without a copy through the socket.
+        XShmSegmentInfo shmInfo{};
+        std::vector<char> buffer;
+        XImage *image{nullptr};
+        bool useSharedMemory{(True == XShmQueryExtension(display))};
+        if (useSharedMemory) {
+            image = XShmCreateImage(display, visual, 24, ZPixmap, nullptr, &shmInfo, m_previewWidth, m_previewHeight);
+            shmInfo.shmid = (nullptr == image) ? -1 : shmget(IPC_PRIVATE, static_cast<std::size_t>(image->bytes_per_line) * static_cast<std::size_t>(image->height), IPC_CREAT | 0600);
+            shmInfo.shmaddr = (0 > shmInfo.shmid) ? reinterpret_cast<char*>(-1) : static_cast<char*>(shmat(shmInfo.shmid, nullptr, 0));
+            if (reinterpret_cast<char*>(-1) != shmInfo.shmaddr) {
+                image->data = shmInfo.shmaddr;
+                shmInfo.readOnly = False;
+                XShmAttach(display, &shmInfo);
+                XSync(display, False);
+            }
+            else {
+                if (nullptr != image) {
+                    XDestroyImage(image);
+                    image = nullptr;
+                }
+                useSharedMemory = false;
+            }
+            if (0 <= shmInfo.shmid) {
+                // The segment is removed as soon as both sides detached.
+                shmctl(shmInfo.shmid, IPC_RMID, nullptr);
+            }
+        }
+        if (!useSharedMemory) {
+            buffer.resize(static_cast<std::size_t>(m_previewWidth) * m_previewHeight * 4);
+            image = XCreateImage(display, visual, 24, ZPixmap, 0, buffer.data(), m_previewWidth, m_previewHeight, 32, 0);
+        }
+        std::clog << "[opendlv-device-camera-pylon]: Preview of " << m_previewWidth << "x" << m_previewHeight << " at up to " << (1000 * 1000 / m_period.count()) << " fps using " << (useSharedMemory ? "MIT-SHM" : "XPutImage") << "." << std::endl;
+
+        uint64_t shownFrame{0};
+        auto next{std::chrono::steady_clock::now()};
+        std::unique_lock<std::mutex> lck(m_stopMutex);
+        while (!m_stop) {
+            next += m_period;
+            if (m_stopCondition.wait_until(lck, next, [this]() { return m_stop; })) {
+                break;
+            }
+            const uint64_t OFFERED{m_offeredFrames.load(std::memory_order_acquire)};
+            const uint8_t *argb{reinterpret_cast<const uint8_t*>(m_latestFrame.load(std::memory_order_acquire))};
+            if ( (OFFERED == shownFrame) || (nullptr == argb) ) {
+                continue;
+            }
+            shownFrame = OFFERED;
+
+            uint8_t *dst{reinterpret_cast<uint8_t*>(image->data)};
+            if ( (m_previewWidth == m_width) && (m_previewHeight == m_height) ) {
+                libyuv::ARGBCopy(argb, static_cast<int>(m_width * 4), dst, image->bytes_per_line, static_cast<int>(m_width), static_cast<int>(m_height));
+            }
+            else {
+                libyuv::ARGBScale(argb, static_cast<int>(m_width * 4), static_cast<int>(m_width), static_cast<int>(m_height),
+                                  dst, image->bytes_per_line, static_cast<int>(m_previewWidth), static_cast<int>(m_previewHeight), libyuv::kFilterBilinear);
+            }
+            if (useSharedMemory) {
+                XShmPutImage(display, window, DefaultGC(display, SCREEN), image, 0, 0, 0, 0, m_previewWidth, m_previewHeight, False);
+            }
+            else {
+                XPutImage(display, window, DefaultGC(display, SCREEN), image, 0, 0, 0, 0, m_previewWidth, m_previewHeight);
+            }
+            // The image must not be changed before the X server has read it.
+            XSync(display, False);
+            m_shownFrames.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (useSharedMemory) {
+            XShmDetach(display, &shmInfo);
+            XSync(display, False);
+            shmdt(shmInfo.shmaddr);
+        }
+        // The pixels are not owned by the image.
+        image->data = nullptr;
+        XDestroyImage(image);
+        XDestroyWindow(display, window);
+        XCloseDisplay(display);
+    }
+
+   private:
+    std::string m_title;
+    uint32_t m_width{0};
+    uint32_t m_height{0};
+    uint32_t m_previewWidth{0};
+    uint32_t m_previewHeight{0};
+    std::chrono::microseconds m_period{0};
+
+    std::atomic<const char*> m_latestFrame{nullptr};
+    std::atomic<uint64_t> m_offeredFrames{0};
+    std::atomic<uint64_t> m_shownFrames{0};
+
+    std::mutex m_stopMutex{};
+    std::condition_variable m_stopCondition{};
+    bool m_stop{false};
+    std::thread m_thread{};
+};
+
+#endif
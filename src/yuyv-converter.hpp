@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2020 Christian Berger
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef YUYV_CONVERTER_HPP
+#define YUYV_CONVERTER_HPP
+
+#include <cstdint>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+    #define YUYV_CONVERTER_X86_64
+    #include <immintrin.h>
+#endif
+
+/**
+ * Fused conversion of packed YUYV (YUV 4:2:2) frames into I420 and ARGB.
+ *
+ * Every pair of source rows is read once to produce the two corresponding
+ * rows of the Y plane, one row of the U and V planes, and, optionally, two
+ * rows of ARGB pixels. The ARGB pixels are computed from the chroma samples
+ * of their own row (BT.601, limited range, 6 bit fixed point as in libyuv)
+ * instead of the vertically averaged I420 chroma.
+ *
+ * On x86_64, an AVX2 or an SSE2 kernel is selected at runtime; the scalar
+ * kernel handles the remaining pixels of a row and other architectures.
+ */
+namespace yuyv {
+
+// Fixed point coefficients (scaled by 64) for BT.601 limited range.
+constexpr int32_t YG{75};
+constexpr int32_t UB{129};
+constexpr int32_t UG{25};
+constexpr int32_t VG{52};
+constexpr int32_t VR{102};
+
+inline uint32_t clamp(int32_t v) noexcept {
+    return static_cast<uint32_t>((v < 0) ? 0 : ((v > 255) ? 255 : v));
+}
+
+/**
+ * Scalar kernel for the pixels [begin, end) of a row pair; begin and end are even.
+ * dstARGB1 is nullptr when only one row is converted (src0 == src1).
+ */
+inline void rowPairScalar(const uint8_t *src0, const uint8_t *src1,
+                          uint8_t *dstY0, uint8_t *dstY1, uint8_t *dstU, uint8_t *dstV,
+                          uint8_t *dstARGB0, uint8_t *dstARGB1, uint32_t begin, uint32_t end) noexcept {
+    for (uint32_t x{begin}; x < end; x += 2) {
+        const uint8_t *s0{src0 + x * 2};
+        const uint8_t *s1{src1 + x * 2};
+        dstY0[x]     = s0[0];
+        dstY0[x + 1] = s0[2];
+        dstY1[x]     = s1[0];
+        dstY1[x + 1] = s1[2];
+        dstU[x / 2] = static_cast<uint8_t>((s0[1] + s1[1] + 1) >> 1);
+        dstV[x / 2] = static_cast<uint8_t>((s0[3] + s1[3] + 1) >> 1);
+    }
+
+    uint8_t *dstARGB[2]{dstARGB0, dstARGB1};
+    const uint8_t *src[2]{src0, src1};
+    for (uint32_t row{0}; row < 2; row++) {
+        if (nullptr == dstARGB[row]) {
+            continue;
+        }
+        uint32_t *dst{reinterpret_cast<uint32_t*>(dstARGB[row])};
+        for (uint32_t x{begin}; x < end; x += 2) {
+            const uint8_t *s{src[row] + x * 2};
+            const int32_t u{static_cast<int32_t>(s[1]) - 128};
+            const int32_t v{static_cast<int32_t>(s[3]) - 128};
+            for (uint32_t i{0}; i < 2; i++) {
+                const int32_t c{(static_cast<int32_t>(s[2 * i]) - 16) * YG + 32};
+                // ARGB is stored as little-endian 32-bit words, i.e., B, G, R, A in memory.
+                dst[x + i] = 0xFF000000u |
+                             (clamp((c + VR * v) >> 6) << 16) |
+                             (clamp((c - UG * u - VG * v) >> 6) << 8) |
+                             clamp((c + UB * u) >> 6);
+            }
+        }
+    }
+}
+
+#ifdef YUYV_CONVERTER_X86_64
+/**
+ * SSE2 kernel converting 16 pixels per iteration; returns the number of
+ * pixels that were converted.
+ */
+inline uint32_t rowPairSSE2(const uint8_t *src0, const uint8_t *src1,
+                            uint8_t *dstY0, uint8_t *dstY1, uint8_t *dstU, uint8_t *dstV,
+                            uint8_t *dstARGB0, uint8_t *dstARGB1, uint32_t width) noexcept {
+    const __m128i LOW_BYTE{_mm_set1_epi16(0x00FF)};
+    const __m128i LOW_WORD{_mm_set1_epi32(0x0000FFFF)};
+    const __m128i ALPHA{_mm_set1_epi8(static_cast<char>(0xFF))};
+
+    auto toARGB = [&](__m128i yuyv, uint8_t *dst) {
+        const __m128i y{_mm_and_si128(yuyv, LOW_BYTE)};
+        const __m128i uv{_mm_srli_epi16(yuyv, 8)};
+        const __m128i u{_mm_sub_epi16(_mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0)), _mm_set1_epi16(128))};
+        const __m128i v{_mm_sub_epi16(_mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1)), _mm_set1_epi16(128))};
+        const __m128i c{_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), _mm_set1_epi16(YG)), _mm_set1_epi16(32))};
+        // Saturation only happens for results beyond 255, which are clamped anyways.
+        const __m128i b{_mm_srai_epi16(_mm_adds_epi16(c, _mm_mullo_epi16(u, _mm_set1_epi16(UB))), 6)};
+        const __m128i g{_mm_srai_epi16(_mm_subs_epi16(_mm_subs_epi16(c, _mm_mullo_epi16(u, _mm_set1_epi16(UG))), _mm_mullo_epi16(v, _mm_set1_epi16(VG))), 6)};
+        const __m128i r{_mm_srai_epi16(_mm_adds_epi16(c, _mm_mullo_epi16(v, _mm_set1_epi16(VR))), 6)};
+        const __m128i bg{_mm_unpacklo_epi8(_mm_packus_epi16(b, b), _mm_packus_epi16(g, g))};
+        const __m128i ra{_mm_unpacklo_epi8(_mm_packus_epi16(r, r), ALPHA)};
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_unpackhi_epi16(bg, ra));
+    };
+
+    uint32_t x{0};
+    for (; x + 16 <= width; x += 16) {
+        const __m128i s0a{_mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + x * 2))};
+        const __m128i s0b{_mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + x * 2 + 16))};
+        const __m128i s1a{_mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + x * 2))};
+        const __m128i s1b{_mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + x * 2 + 16))};
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstY0 + x), _mm_packus_epi16(_mm_and_si128(s0a, LOW_BYTE), _mm_and_si128(s0b, LOW_BYTE)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstY1 + x), _mm_packus_epi16(_mm_and_si128(s1a, LOW_BYTE), _mm_and_si128(s1b, LOW_BYTE)));
+
+        const __m128i uva{_mm_avg_epu16(_mm_srli_epi16(s0a, 8), _mm_srli_epi16(s1a, 8))};
+        const __m128i uvb{_mm_avg_epu16(_mm_srli_epi16(s0b, 8), _mm_srli_epi16(s1b, 8))};
+        const __m128i u{_mm_packs_epi32(_mm_and_si128(uva, LOW_WORD), _mm_and_si128(uvb, LOW_WORD))};
+        const __m128i v{_mm_packs_epi32(_mm_srli_epi32(uva, 16), _mm_srli_epi32(uvb, 16))};
+        const __m128i uv{_mm_packus_epi16(u, v)};
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dstU + x / 2), uv);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dstV + x / 2), _mm_srli_si128(uv, 8));
+
+        if (nullptr != dstARGB0) {
+            toARGB(s0a, dstARGB0 + x * 4);
+            toARGB(s0b, dstARGB0 + x * 4 + 32);
+        }
+        if (nullptr != dstARGB1) {
+            toARGB(s1a, dstARGB1 + x * 4);
+            toARGB(s1b, dstARGB1 + x * 4 + 32);
+        }
+    }
+    return x;
+}
+
+/**
+ * Converts 16 YUYV pixels into ARGB using AVX2.
+ */
+__attribute__((target("avx2")))
+inline void yuyvToARGBAVX2(__m256i yuyv, uint8_t *dst) noexcept {
+    const __m256i y{_mm256_and_si256(yuyv, _mm256_set1_epi16(0x00FF))};
+    const __m256i uv{_mm256_srli_epi16(yuyv, 8)};
+    const __m256i u{_mm256_sub_epi16(_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0)), _mm256_set1_epi16(128))};
+    const __m256i v{_mm256_sub_epi16(_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1)), _mm256_set1_epi16(128))};
+    const __m256i c{_mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(16)), _mm256_set1_epi16(YG)), _mm256_set1_epi16(32))};
+    const __m256i b{_mm256_srai_epi16(_mm256_adds_epi16(c, _mm256_mullo_epi16(u, _mm256_set1_epi16(UB))), 6)};
+    const __m256i g{_mm256_srai_epi16(_mm256_subs_epi16(_mm256_subs_epi16(c, _mm256_mullo_epi16(u, _mm256_set1_epi16(UG))), _mm256_mullo_epi16(v, _mm256_set1_epi16(VG))), 6)};
+    const __m256i r{_mm256_srai_epi16(_mm256_adds_epi16(c, _mm256_mullo_epi16(v, _mm256_set1_epi16(VR))), 6)};
+    const __m256i bg{_mm256_unpacklo_epi8(_mm256_packus_epi16(b, b), _mm256_packus_epi16(g, g))};
+    const __m256i ra{_mm256_unpacklo_epi8(_mm256_packus_epi16(r, r), _mm256_set1_epi8(static_cast<char>(0xFF)))};
+    // Packing and unpacking work per 128 bit lane; restore the pixel order.
+    const __m256i lo{_mm256_unpacklo_epi16(bg, ra)};
+    const __m256i hi{_mm256_unpackhi_epi16(bg, ra)};
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+/**
+ * AVX2 kernel converting 32 pixels per iteration; returns the number of
+ * pixels that were converted.
+ */
+__attribute__((target("avx2")))
+inline uint32_t rowPairAVX2(const uint8_t *src0, const uint8_t *src1,
+                            uint8_t *dstY0, uint8_t *dstY1, uint8_t *dstU, uint8_t *dstV,
+                            uint8_t *dstARGB0, uint8_t *dstARGB1, uint32_t width) noexcept {
+    const __m256i LOW_BYTE{_mm256_set1_epi16(0x00FF)};
+    const __m256i LOW_WORD{_mm256_set1_epi32(0x0000FFFF)};
+    const __m256i UV_ORDER{_mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)};
+
+    uint32_t x{0};
+    for (; x + 32 <= width; x += 32) {
+        const __m256i s0a{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src0 + x * 2))};
+        const __m256i s0b{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src0 + x * 2 + 32))};
+        const __m256i s1a{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src1 + x * 2))};
+        const __m256i s1b{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src1 + x * 2 + 32))};
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dstY0 + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(s0a, LOW_BYTE), _mm256_and_si256(s0b, LOW_BYTE)), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dstY1 + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(s1a, LOW_BYTE), _mm256_and_si256(s1b, LOW_BYTE)), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        const __m256i uva{_mm256_avg_epu16(_mm256_srli_epi16(s0a, 8), _mm256_srli_epi16(s1a, 8))};
+        const __m256i uvb{_mm256_avg_epu16(_mm256_srli_epi16(s0b, 8), _mm256_srli_epi16(s1b, 8))};
+        const __m256i u{_mm256_packs_epi32(_mm256_and_si256(uva, LOW_WORD), _mm256_and_si256(uvb, LOW_WORD))};
+        const __m256i v{_mm256_packs_epi32(_mm256_srli_epi32(uva, 16), _mm256_srli_epi32(uvb, 16))};
+        const __m256i uv{_mm256_permutevar8x32_epi32(_mm256_packus_epi16(u, v), UV_ORDER)};
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstU + x / 2), _mm256_castsi256_si128(uv));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dstV + x / 2), _mm256_extracti128_si256(uv, 1));
+
+        if (nullptr != dstARGB0) {
+            yuyvToARGBAVX2(s0a, dstARGB0 + x * 4);
+            yuyvToARGBAVX2(s0b, dstARGB0 + x * 4 + 64);
+        }
+        if (nullptr != dstARGB1) {
+            yuyvToARGBAVX2(s1a, dstARGB1 + x * 4);
+            yuyvToARGBAVX2(s1b, dstARGB1 + x * 4 + 64);
+        }
+    }
+    return x;
+}
+#endif
+
+using RowPairKernel = uint32_t (*)(const uint8_t*, const uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint32_t);
+
+/**
+ * @return The fastest kernel supported by this CPU or nullptr if there is none.
+ */
+inline RowPairKernel selectKernel() noexcept {
+#ifdef YUYV_CONVERTER_X86_64
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &rowPairAVX2;
+    }
+    return &rowPairSSE2;
+#else
+    return nullptr;
+#endif
+}
+
+/**
+ * @return Human-readable name of the kernel that is used on this CPU.
+ */
+inline const char *kernelName() noexcept {
+#ifdef YUYV_CONVERTER_X86_64
+    return (&rowPairAVX2 == selectKernel()) ? "AVX2" : "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+/**
+ * Converts the rows [beginRow, endRow) of a YUYV frame into I420 and,
+ * optionally, ARGB while reading every source row only once; beginRow must
+ * be even.
+ *
+ * @param src YUYV frame.
+ * @param srcStride Bytes per row of src.
+ * @param dstY Y plane of the I420 frame (stride: width).
+ * @param dstU U plane of the I420 frame (stride: width/2).
+ * @param dstV V plane of the I420 frame (stride: width/2).
+ * @param dstARGB ARGB frame (stride: width*4) or nullptr to skip ARGB.
+ * @param width Width of the frame; must be even.
+ * @param beginRow First row to convert.
+ * @param endRow Row after the last row to convert.
+ */
+inline void toI420AndARGB(const uint8_t *src, uint32_t srcStride,
+                          uint8_t *dstY, uint8_t *dstU, uint8_t *dstV, uint8_t *dstARGB,
+                          uint32_t width, uint32_t beginRow, uint32_t endRow) noexcept {
+    static const RowPairKernel KERNEL{selectKernel()};
+    const uint32_t CHROMA_WIDTH{width / 2};
+    for (uint32_t row{beginRow}; row < endRow; row += 2) {
+        // With an odd number of rows, the last row provides the chroma samples on its own.
+        const uint32_t nextRow{(row + 1 < endRow) ? row + 1 : row};
+        const uint8_t *src0{src + row * srcStride};
+        const uint8_t *src1{src + nextRow * srcStride};
+        uint8_t *dstY0{dstY + row * width};
+        uint8_t *dstY1{dstY + nextRow * width};
+        uint8_t *dstU0{dstU + (row / 2) * CHROMA_WIDTH};
+        uint8_t *dstV0{dstV + (row / 2) * CHROMA_WIDTH};
+        uint8_t *dstARGB0{(nullptr != dstARGB) ? dstARGB + row * width * 4 : nullptr};
+        uint8_t *dstARGB1{((nullptr != dstARGB) && (nextRow != row)) ? dstARGB + nextRow * width * 4 : nullptr};
+
+        const uint32_t converted{(nullptr != KERNEL) ? KERNEL(src0, src1, dstY0, dstY1, dstU0, dstV0, dstARGB0, dstARGB1, width) : 0};
+        rowPairScalar(src0, src1, dstY0, dstY1, dstU0, dstV0, dstARGB0, dstARGB1, converted, width);
+    }
+}
+
+/**
+ * Extracts the rows [beginRow, endRow) of the luma of a YUYV frame into a
+ * GRAY8 frame without touching the chroma samples.
+ *
+ * @param src YUYV frame.
+ * @param srcStride Bytes per row of src.
+ * @param dst GRAY8 frame (stride: width).
+ * @param width Width of the frame.
+ * @param beginRow First row to convert.
+ * @param endRow Row after the last row to convert.
+ */
+inline void toGray(const uint8_t *src, uint32_t srcStride, uint8_t *dst,
+                   uint32_t width, uint32_t beginRow, uint32_t endRow) noexcept {
+    for (uint32_t row{beginRow}; row < endRow; row++) {
+        const uint8_t *s{src + row * srcStride};
+        uint8_t *d{dst + row * width};
+        uint32_t x{0};
+#ifdef YUYV_CONVERTER_X86_64
+        const __m128i LOW_BYTES{_mm_set1_epi16(0x00ff)};
+        for (; x + 16 <= width; x += 16) {
+            const __m128i a{_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 2 * x)), LOW_BYTES)};
+            const __m128i b{_mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 2 * x + 16)), LOW_BYTES)};
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + x), _mm_packus_epi16(a, b));
+        }
+#endif
+        for (; x < width; x++) {
+            d[x] = s[2 * x];
+        }
+    }
+}
+
+}
+
+#endif